@@ -85,13 +85,18 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
     bool removeRows( int row, int count, const QModelIndex & parent = QModelIndex() );
 
-    void emitLayoutChanged();
-    void emitLayoutAboutToBeChanged();
     void updateAnnounceFromDatabase(int annId);
     //    void updateAnnounceFromDatabase(int newAnnId, int oldAnnId);
-    bool isInTable(int annId);
+    bool isInTable(int annId) const;
+    // Row of the announcement with id <annId>, or -1 if it is not in the table
+    int rowForAnnounce(int annId) const;
 
     QList<Announcement> announceList;
+
+private:
+    // Announcement id to row of announceList
+    QHash<int,int> rowById;
+    void updateRows(int from);
 };
 
 class AnnounceProxyModel : public QSortFilterProxyModel
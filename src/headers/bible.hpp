@@ -21,6 +21,8 @@
 #define BIBLE_HPP
 
 #include <QtSql>
+#include <QFuture>
+#include "biblesearchindex.hpp"
 #include "theme.hpp"
 #include "settings.hpp"
 
@@ -35,6 +37,31 @@ public:
     QString verseText;
 };
 
+class BibleVerseStore
+{
+    // Compact in-memory store of the operator Bible. Verses are kept in
+    // contiguous arrays sorted by book, chapter and verse, so that a chapter
+    // is a single index range and lookups do not depend on Bible size.
+public:
+    void clear();
+    void build(QList<BibleVerse> &verses);
+    int count() const { return verseIds.count(); }
+    int indexOf(const QString &verseId) const;
+    bool chapterRange(int book, int chapter, int &first, int &last) const;
+    bool bookRange(int book, int &first, int &last) const;
+
+    QVector<QString> verseIds;
+    QVector<int> books;
+    QVector<int> chapters;
+    QVector<int> verseNumbers;
+    QVector<QString> verseTexts;
+private:
+    static quint32 chapterKey(int book, int chapter) { return (quint32(book) << 16) | quint32(chapter & 0xFFFF); }
+    QHash<QString,int> idIndex;
+    QHash<quint32,QPair<int,int> > chapterIndex; // (book,chapter) -> [first,last)
+    QHash<int,QPair<int,int> > bookIndex; // book -> [first,last)
+};
+
 class Verse
 {
 public:
@@ -88,9 +115,9 @@ public:
     QStringList currentIdList; // Verses that are in the show list
     QList<BibleBook> books;
 public slots:
-    QList<BibleSearch> searchBible(bool begins, QRegularExpression searchExp);
-    QList<BibleSearch> searchBible(bool allWords, QRegularExpression searchExp, int book);
-    QList<BibleSearch> searchBible(bool allWords, QRegularExpression searchExp, int book, int chapter);
+    QList<BibleSearch> searchBible(int type, QStringList words, QRegularExpression searchExp);
+    QList<BibleSearch> searchBible(int type, QStringList words, QRegularExpression searchExp, int book);
+    QList<BibleSearch> searchBible(int type, QStringList words, QRegularExpression searchExp, int book, int chapter);
     QStringList getBooks();
     QString getBookName(int id);
     void getVerseRef(QString vId, QString &book, int &chapter, int &verse);
@@ -99,15 +126,24 @@ public slots:
     void getVerseAndCaption(QString &verse, QString &caption, QString verId, QString &bibId, bool useAbbr);
     int getCurrentBookRow(QString book);
     Verse getCurrentVerseAndCaption(QList<int> currentRows, BibleSettings& sets, BibleVersionSettings& bv);
+    void clearVerseCache();
     void setBiblesId(QString& id);
     QString getBibleName();
-    void loadOperatorBible();
+    void loadOperatorBible(bool withSearchIndex = true);
 private:
     QString bibleId;
-    QList<BibleVerse> operatorBible;
+    BibleVerseStore operatorBible;
+    BibleSearchIndex searchIndex;
+    QFuture<BibleSearchIndex> searchIndexFuture;
+    // Resolved verse text and caption, keyed by verse ids, Bible id and abbreviation use
+    QHash<QString,QPair<QString,QString> > verseCache;
     void retrieveBooks();
+    bool isSearchIndexReady();
+    QString currentVerseIds(const QList<int> &currentRows);
+    void getCachedVerseAndCaption(QString &verse, QString &caption, const QString &verId, QString &bibId, bool useAbbr);
 private slots:
-    void addSearchResult(const BibleVerse &bv,QList<BibleSearch> &bsl);
+    QList<BibleSearch> searchRange(int type, const QStringList &words, const QRegularExpression &searchExp, int first, int last);
+    void addSearchResult(int index, QList<BibleSearch> &bsl);
 };
 
 #endif // BIBLE_HPP
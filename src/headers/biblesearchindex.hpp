@@ -0,0 +1,54 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#ifndef BIBLESEARCHINDEX_HPP
+#define BIBLESEARCHINDEX_HPP
+
+#include <QtCore>
+
+class BibleSearchIndex
+{
+    // Inverted full-text index of the operator Bible. Maps case folded
+    // word tokens to ascending lists of verse indices in BibleVerseStore.
+public:
+    BibleSearchIndex();
+    static BibleSearchIndex build(QString bibleId, QVector<QString> verseTexts);
+    bool isEmpty() const { return postings.isEmpty(); }
+    QVector<int> lookup(const QString &word) const;
+    static QStringList tokenize(const QString &text);
+    static QVector<int> intersect(const QVector<int> &a, const QVector<int> &b);
+    static QVector<int> unite(const QVector<int> &a, const QVector<int> &b);
+
+private:
+    QByteArray stamp;
+    QHash<QString,QVector<int> > postings;
+    // Every token of postings, and the ascending indices into it of the
+    // tokens that hold each substring of up to three characters
+    QVector<QString> words;
+    QHash<QString,QVector<int> > grams;
+    // Cleared when it grows past a limit
+    mutable QHash<QString,QVector<int> > lookupCache;
+    void buildGrams();
+    static QString cacheFileName(const QString &bibleId);
+    static QByteArray makeStamp(const QVector<QString> &verseTexts);
+    bool load(const QString &fileName, const QByteArray &expectedStamp);
+    void save(const QString &fileName) const;
+};
+
+#endif // BIBLESEARCHINDEX_HPP
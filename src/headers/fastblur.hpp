@@ -0,0 +1,51 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#ifndef FASTBLUR_HPP
+#define FASTBLUR_HPP
+
+#include <QImage>
+#include <QRect>
+
+class FastBlur
+{
+    // Gaussian-like blur of premultiplied ARGB images, done as three separable
+    // box passes in each direction with running sums. Uses AVX2 or SSE2 when
+    // available and a scalar loop otherwise; all paths give identical output.
+    // Safe to call from any thread.
+public:
+    enum Implementation
+    {
+        Automatic,
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    // Blurs the pixels around rect in place; everything the blur can spread
+    // into is processed, the rest of the image is left untouched.
+    static void blurPremultiplied(QImage &image, const QRect &rect, int radius);
+    // How far in pixels the blur spreads content for the given radius
+    static int extent(int radius);
+    // Forces one code path so tests can compare them. Returns false when
+    // the path is not built in or not supported by this CPU.
+    static bool setImplementation(Implementation implementation);
+};
+
+#endif // FASTBLUR_HPP
@@ -25,6 +25,11 @@
 #include <QGraphicsBlurEffect>
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
+#include <QCache>
+#include <QImage>
+#include <QFuture>
+#include <QSharedPointer>
+#include <functional>
 #include "settings.hpp"
 #include "displaysetting.hpp"
 #include "bible.hpp"
@@ -36,22 +41,38 @@ class ImageGenerator
 public:
     ImageGenerator();
     void setScreenSize(QSize size);
+    void setRenderCacheBudget(int megabytes);
+    // Hit, miss and eviction counters, for sizing the cache budget
+    QString renderCacheStatistics() const;
     QSize getScreenSize();
 
     QPixmap generateEmptyImage();
     QPixmap generateColorImage(QColor &color);
-    QPixmap generateBibleImage(Verse verse, BibleSettings &bSets);
-    QPixmap generateSongImage(Stanza stanza, SongSettings &sSets);
-    QPixmap generateAnnounceImage(AnnounceSlide announce, TextSettings &aSets);
+    // Text images only cover the text, offset() gives their position on the screen
+    QImage generateBibleImage(Verse verse, BibleSettings &bSets);
+    QImage generateSongImage(Stanza stanza, SongSettings &sSets);
+    QImage generateAnnounceImage(AnnounceSlide announce, TextSettings &aSets);
+
+    // Render slides on a worker thread ahead of time, into the render cache
+    void prerenderBibleImage(Verse verse, BibleSettings &bSets);
+    void prerenderSongImage(Stanza stanza, SongSettings &sSets);
+    void prerenderAnnounceImage(AnnounceSlide announce, TextSettings &aSets);
 
     int width();
     int height();
 
+    // Leave the drop shadow out of text images when the display can draw it
+    // on the GPU. textShadow() tells whether the last generated image needs
+    // one, and how it looks.
+    void setDeferShadow(bool defer);
+    bool textShadow(QColor *color, int *offset, qreal *blurRadius);
+
 private:
     QSize m_screenSize;
     bool m_shadow, m_blurShadow, m_isTextPrepared, m_bibleAddBKColorToText, m_songAddBKColorToText, m_announcementAddBKColorToText;
     int m_type; // 0 = empty, 1 = bible, 2 = song, 3 = announce
     int m_shadowOffset, m_blurRadius;
+    bool m_deferShadow;
     QColor m_bibleTextRecBKColor, m_bibleTextGenBKColor, m_songTextRecBKColor, m_songTextGenBKColor, m_announcementTextRecBKColor, m_announcementTextGenBKColor;
 
     Verse m_verse;
@@ -67,15 +88,43 @@ private:
     AnnounceDisplaySettings m_adSets;
 
 
-    QPixmap renderText();
+    // LRU cache of rendered text images, cost is in kilobytes
+    QCache<QByteArray,QImage> m_renderCache;
+    quint64 m_cacheHits, m_cacheMisses, m_cacheEvictions, m_prerendered;
+    // Union of the rects text was drawn into by the last render, padded
+    // for glyphs that overhang them
+    QRect m_textBounds;
+    qint64 m_blurNanoseconds, m_blurCount;
+    // Render-ahead jobs that have not been collected into the cache yet
+    QHash<QByteArray,QFuture<QImage> > m_prerenders;
+
+    void prepareBibleText(Verse verse, BibleSettings &bSets);
+    void prepareSongText(Stanza stanza, SongSettings &sSets);
+    void prepareAnnounceText(AnnounceSlide announce, TextSettings &aSets);
+    QImage renderText();
+    QImage renderTextUncached();
+    void drawText(QPainter *painter, bool isShadow);
+    void addTextBounds(QPainter *painter, const QRect &drawn);
+    QRect textRegion();
+    bool isShadowDeferred(QColor *color = nullptr);
+    QByteArray renderCacheKey();
+    void insertRenderCache(const QByteArray &key, const QImage &image);
+    QSharedPointer<ImageGenerator> createPrerenderJob();
+    void schedulePrerender(QSharedPointer<ImageGenerator> job);
+    void collectPrerendered();
+
+    // Average glyph metrics at 1 pt per font, used to seed font size fitting
+    QHash<QString,QPointF> m_glyphMetrics;
+    quint64 m_fitLayouts;
+    int fitPointSize(int minSize, int maxSize, int estimate, const std::function<bool(int)> &fits);
+    int estimatePointSize(const QFont &font, const QString &text, int width, int height, bool wrap);
 
     QRect boundRectOrDrawText(QPainter *painter, bool draw, int left, int top, int width, int height, int flags, QString text);
     void drawBibleText(QPainter *painter, bool isShadow);
     void drawBibleTextToRect(QPainter *painter, QRect& trect, QRect& crect, QString ttext, QString ctext, int tflags, int cflags, int top, int left, int width, int height);
+    void fillBibleTextBackground(QPainter *painter, const QRect &trect, const QRect &crect, int top, int left, int width, int height);
     void drawSongText(QPainter *painter, bool isShadow);
     void drawAnnounceText(QPainter *painter, bool isShadow);
-//    void fastbluralpha(QImage &img, int radius);
-    QPixmap applyEffectToImage(QPixmap src, QGraphicsEffect *effect);
 
 };
 
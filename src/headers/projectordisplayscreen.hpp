@@ -57,6 +57,9 @@ public slots:
     void renderBibleText(Verse bVerse, BibleSettings &bSets);
     void renderSongText(Stanza stanza, SongSettings &sSets);
     void renderAnnounceText(AnnounceSlide announce, TextSettings &aSets);
+    void prerenderBibleText(Verse bVerse, BibleSettings &bSets);
+    void prerenderSongText(Stanza stanza, SongSettings &sSets);
+    void prerenderAnnounceText(AnnounceSlide announce, TextSettings &aSets);
     void renderSlideShow(QPixmap slide,SlideShowSettings &ssSets);
     void renderVideo(VideoInfo videoDetails);
 
@@ -78,10 +81,12 @@ public slots:
 private slots:
     void setBackPixmap(QPixmap p,int fillMode); // 0 = Strech, 1 = keep aspect, 2 = keep aspect by expanding
     void setBackPixmap(QPixmap p, QColor c);
-    void setTextPixmap(QPixmap p);
+    void setTextPixmap(QPixmap p, QPoint offset = QPoint(0,0)); // offset is the position on the screen
+    void setTextImage(const QImage &image);
     void setBackVideo(QString path);
     void setVideoSource(QObject *playerObject, QUrl path);
     void updateScreen();
+    void updateShadowDeferral();
 
     void exitSlideClicked();
     void nextSlideClicked();
@@ -108,9 +113,8 @@ protected:
 private:
     Ui::ProjectorDisplayScreen *ui;
     QQuickView *dispView;
-    SpImageProvider *imProvider;
+    SpImageProvider *imProvider; // owned by the engine of dispView
     ImageGenerator imGen;
-    bool backImSwitch1, textImSwitch1, backImSwitch2, textImSwitch2;
     bool isNewBack, back1to2, text1to2;
     int tranType,backType;
     QColor m_color;
@@ -119,6 +123,7 @@ private:
     QSize m_effectiveRenderSize;
 
     QSize calculateEffectiveRenderSize();
+    void showTextImage(const QImage &image, bool generated);
     QSize getFormatResolution() const;
 
     QPixmap back;
@@ -327,6 +327,8 @@ public:
     int streamThemeId;
     bool mirrorDisplay1;
     bool displayIsOnTop;
+    int backgroundCodec; // VirtualOutput::AssetCodec
+    int streamFrameRate;
 
     void save();
     void save(QSqlQuery &sq);
@@ -231,6 +231,9 @@ protected:
 
 private:
     Theme getVirtualOutputTheme();
+    // Theme of the virtual output when it does not mirror display 1
+    Theme streamTheme;
+    bool streamThemeLoaded;
     Ui::SoftProjectorClass *ui;
     SettingsDialog *settingsDialog;
     HelpDialog *helpDialog;
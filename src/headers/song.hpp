@@ -31,17 +31,10 @@ bool isStanzaRefrainTitle(QString string);
 bool isStanzaAndRefrainTitle(QString string);
 bool isStanzaSlideTitle(QString string);
 
-class Stanza
+class SongFormat
 {
-    // Class to hold current verse text and song info to send to projection
+    // Song level formatting, shared by every stanza of a song
 public:
-    int number;
-    QString stanza;
-    QString stanzaTitle;
-    QString wordsBy;
-    QString musicBy;
-    QString tune;
-    bool isLast;
     bool usePrivateSettings;
     int alignmentV;
     int alignmentH;
@@ -56,6 +49,20 @@ public:
     QPixmap background;
 };
 
+class Stanza
+{
+    // Class to hold current verse text and song info to send to projection
+public:
+    int number;
+    QString stanza;
+    QString stanzaTitle;
+    QString wordsBy;
+    QString musicBy;
+    QString tune;
+    bool isLast;
+    QSharedPointer<const SongFormat> format;
+};
+
 class Song
 {
     // Class for storing song information: number, name, songbook
@@ -66,6 +73,8 @@ public:
     Song(int id);
     Song(int id, int num, QString songbook_id, QString songbook_name);
     void readData();
+    void readCatalogData();
+    Song catalogEntry() const;
     void saveUpdate();
     void saveNew();
     QStringList getSongTextList();
@@ -100,6 +109,15 @@ public:
     QPixmap background;
 
 private:
+    // Ordered stanzas and formatting, built once per revision of the song and
+    // shared by the copies handed to each screen
+    QStringList stanzaList;
+    QString stanzaListText;
+    bool stanzaListValid;
+    QSharedPointer<const SongFormat> songFormat;
+    QSharedPointer<const SongFormat> getFormat();
+    QStringList buildSongTextList();
+
     void setDefaults();
     QString getStanzaBlock(int &i, QStringList &list);
     void removeLastChorus(QStringList ct, QStringList &list);
@@ -124,11 +142,26 @@ public:
 
     bool removeRows( int row, int count, const QModelIndex & parent = QModelIndex() );
     QList<Song> song_list;
-    void emitLayoutChanged();
-    void emitLayoutAboutToBeChanged();
     void updateSongFromDatabase(int songid);
     void updateSongFromDatabase(int newSongId, int oldSongId);
-    bool isInTable(int songid);
+    bool isInTable(int songid) const;
+    // Row of the song with id <songid>, or -1 if it is not in the table
+    int rowForSong(int songid) const;
+
+    // Case folded, diacritic free text that filters compare against
+    static QString filterKey(const QString &text);
+    const QString &titleKey(int row) const { return title_keys.at(row); }
+    const QString &numberKey(int row) const { return number_keys.at(row); }
+
+private:
+    // Filter keys, one per row of song_list
+    QStringList title_keys;
+    QStringList number_keys;
+    void updateKeys(int row);
+    // Song id to row of song_list
+    QHash<int,int> row_by_id;
+    void updateRows(int from);
+    void emitRowChanged(int row);
 };
 
 class SongProxyModel : public QSortFilterProxyModel
@@ -143,8 +176,11 @@ public:
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
 
 private:
-    QString filter_string, songbook_filter, category_filter;
+    QString filter_string, filter_key, songbook_filter;
+    int category_filter;
     bool match_beginning, exact_match;
+    // Compiled once per filter change, not per row
+    QRegularExpression filter_rx;
 };
 
 class SongDatabase
@@ -159,6 +195,14 @@ public:
     Song getSong(int id);
     QList<Song> getSongs();
     int lastUser(QString songbook_id);
+
+    // Catalog entries only carry id, songbook, number, title, category and
+    // tune. Full songs are read on demand and kept in a bounded cache.
+    static Song loadSong(const Song &entry);
+    static void forgetSong(int songId);
+
+private:
+    static QCache<int,Song> &songCache();
 };
 
 #endif // SONG_HPP
@@ -0,0 +1,55 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#ifndef SONGSEARCHINDEX_HPP
+#define SONGSEARCHINDEX_HPP
+
+#include <QtSql>
+
+class SongSearchIndex
+{
+    // Full-text index of song titles and lyrics, kept in SQLite FTS5 tables
+    // that read their text from the Songs table. Triggers on Songs keep them
+    // in step with every write. A word index answers the word searches of
+    // the song tab, a trigram index the phrase searches and songs that no
+    // word matches because of typos. Only to be used from the GUI thread.
+public:
+    // Same order as the search types in the song tab
+    enum SearchType
+    {
+        CONTAINS_PHRASE,
+        CONTAINS_WORD_PHRASE,
+        LINE_BEGINS,
+        CONTAINS_ANY_WORD,
+        CONTAINS_ALL_WORDS
+    };
+
+    static bool isAvailable();
+    // Creates the index tables and their triggers, building the index from
+    // Songs when they are new
+    static void synchronize();
+
+    // Returns false if the index can't answer the search, the songs have to
+    // be scanned then. Otherwise songIds gets the ids of matching songs, best
+    // first. For search types that need more than whole words, verify has to
+    // be the pattern the scan would use, candidates are checked against it.
+    static bool search(const QString &text, int type, const QRegularExpression &verify, QList<int> *songIds);
+};
+
+#endif // SONGSEARCHINDEX_HPP
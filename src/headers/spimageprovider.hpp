@@ -21,18 +21,29 @@
 #define SPIMAGEPROVIDER_HPP
 
 #include <QQuickImageProvider>
-
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+
+// Keyed image store for one display screen. Each layer has its own slot, so
+// background and text updates never overwrite each other. Ids requested by
+// QML are "<slot>/<version>", the version only changes the URL so that the
+// Image item reloads.
 class SpImageProvider : public QQuickImageProvider
 {
 
 public:
     SpImageProvider();
-    QPixmap requestPixmap(const QString &id, QSize *size, const QSize &requestedSize);
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
 
-    void setPixMap(QPixmap &p);
+    // Stores the image for slot and returns the id to load it with
+    QString setImage(const QString &slot, const QImage &image);
+    void clearImage(const QString &slot);
 
 private:
-    QPixmap m_pixmap;
+    QMutex m_mutex;
+    QHash<QString, QImage> m_images;
+    quint64 m_version;
 };
 
 
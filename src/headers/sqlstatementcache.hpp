@@ -0,0 +1,41 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#ifndef SQLSTATEMENTCACHE_HPP
+#define SQLSTATEMENTCACHE_HPP
+
+#include <QtSql>
+
+class SqlStatementCache
+{
+    // Keeps prepared statements alive between calls, keyed by connection and
+    // SQL text, so that SQLite does not re-parse and re-plan queries that run
+    // on every slide or list load. Values are passed with addBindValue().
+    // Only to be used from the GUI thread.
+public:
+    static QSqlQuery &query(const QString &sql,
+                            const QString &connection = QLatin1String(QSqlDatabase::defaultConnection));
+    static bool exec(QSqlQuery &query);
+    // Per-statement timing is off by default, it costs a clock read per query
+    static void setTimingEnabled(bool enabled);
+    static QStringList timingReport();
+    static void clear();
+};
+
+#endif // SQLSTATEMENTCACHE_HPP
@@ -21,17 +21,16 @@
 #define VIRTUALOUTPUT_HPP
 
 #include <QObject>
+#include <QCache>
 #include <QColor>
 #include <QFont>
+#include <QImage>
 #include <QPixmap>
-#include <QSet>
-#include <QTcpServer>
-#include <QTcpSocket>
+#include <QThread>
 #include <QMediaPlayer>
 #include <QUrl>
-#include <QtWebSockets/QWebSocket>
-#include <QtWebSockets/QWebSocketServer>
 #include "imagegenerator.hpp"
+#include "virtualoutputserver.hpp"
 #include "settings.hpp"
 #include "bible.hpp"
 #include "song.hpp"
@@ -51,6 +50,14 @@ public:
         RES_CUSTOM
     };
 
+    enum AssetCodec
+    {
+        CODEC_PNG,
+        CODEC_PNG_FAST,
+        CODEC_JPEG,
+        CODEC_WEBP
+    };
+
     explicit VirtualOutput(QObject *parent = nullptr);
     ~VirtualOutput();
 
@@ -66,6 +73,18 @@ public:
     bool isMirroringDisplay1() const { return m_mirrorDisplay1; }
     int getThemeId() const { return m_themeId; }
 
+    // Lossy codecs are only used for images without transparency, anything
+    // else falls back to fast PNG
+    void setBackgroundCodec(AssetCodec codec);
+    void setTextCodec(AssetCodec codec);
+    AssetCodec getBackgroundCodec() const { return m_backgroundCodec; }
+    AssetCodec getTextCodec() const { return m_textCodec; }
+    QString encodeStatistics() const;
+
+    // Frame rate of the composited /stream.mjpeg output, at the output resolution
+    void setStreamFrameRate(int fps);
+    int getStreamFrameRate() const { return m_streamFrameRate; }
+
     void setLogoOverlay(const QString &imagePath);
     void setLowerThirdConfig(bool show, const QString &text, const QFont &font,
                              const QColor &bgColor, const QColor &textColor);
@@ -82,6 +101,9 @@ public slots:
     void renderBibleText(Verse verse, BibleSettings &settings);
     void renderSongText(Stanza stanza, SongSettings &settings);
     void renderAnnounceText(AnnounceSlide announce, TextSettings &settings);
+    void prerenderBibleText(Verse verse, BibleSettings &settings);
+    void prerenderSongText(Stanza stanza, SongSettings &settings);
+    void prerenderAnnounceText(AnnounceSlide announce, TextSettings &settings);
     void renderSlideShow(QPixmap slide, SlideShowSettings &settings);
     void renderVideo(VideoInfo videoDetails);
 
@@ -118,54 +140,83 @@ signals:
 #endif
     void videoStopped();
 
+    void snapshotReady(VirtualOutputSnapshotPtr snapshot);
+
 protected:
     void keyReleaseEvent(QKeyEvent *event);
 
-private slots:
-    void onNewHttpConnection();
-    void onSocketReadyRead();
-    void onSocketDisconnected();
-    void onNewWebSocketConnection();
-    void onWebSocketDisconnected();
-
 private:
+    // Changed tiles of a text layer against an earlier one with the same placement
+    struct TextDelta
+    {
+        QByteArray data;
+        QVector<QRect> tiles;
+        int columns;
+        quint64 base;
+
+        TextDelta() : columns(0), base(0) {}
+    };
+
     struct AssetState
     {
         QByteArray data;
         QString contentType;
+        QRect rect;
+        TextDelta delta;
         quint64 version;
         bool available;
 
-        AssetState() : version(0), available(false) {}
+        // Identifies the source image, fill mode, size and codec behind data
+        QString sourceKey;
+
+        // Encodes are numbered so that late results of replaced images are dropped
+        quint64 serial;
+        qint64 encodeNanoseconds, totalEncodeNanoseconds;
+        qint64 encodeCount, totalBytes;
+
+        AssetState() : version(0), available(false), serial(0),
+            encodeNanoseconds(0), totalEncodeNanoseconds(0), encodeCount(0), totalBytes(0) {}
     };
 
+    struct EncodedAsset
+    {
+        QByteArray data;
+        QString contentType;
+        QRect rect;
+        TextDelta delta;
+        qint64 nanoseconds;
+        quint64 version;
+
+        EncodedAsset() : nanoseconds(0), version(0) {}
+    };
+
+    static EncodedAsset encodeImage(const QImage &image, const QSize &size, int fillMode, int codec,
+                                    const QImage &previous);
+    static void encodeTextDelta(const QImage &image, const QImage &previous, TextDelta *delta);
+    void encodeAsset(AssetState *asset, const QImage &image, int fillMode, AssetCodec codec,
+                     const QString &cacheKey = QString(), const QImage &previous = QImage(),
+                     quint64 deltaBase = 0);
+    void finishEncode(AssetState *asset, quint64 serial, const QString &cacheKey, const EncodedAsset &encoded);
+    void publishAsset(AssetState *asset, const EncodedAsset &encoded);
+    QString assetStatistics(const QString &name, const AssetState &asset) const;
+
     bool startServers();
     void stopServers();
-    void resetHttpSocket(QTcpSocket *socket);
-    void handleHttpRequest(QTcpSocket *socket, const QByteArray &requestData);
-    void sendHttpResponse(QTcpSocket *socket, const QByteArray &statusLine,
-                          const QByteArray &contentType, const QByteArray &body,
-                          const QList<QByteArray> &extraHeaders = QList<QByteArray>(),
-                          bool sendBody = true, qint64 contentLength = -1);
-    void sendImageResponse(QTcpSocket *socket, const AssetState &asset, bool sendBody);
-    void sendMediaResponse(QTcpSocket *socket, const QString &filePath, bool sendBody,
-                           const QByteArray &rangeHeader = QByteArray());
-    void sendNotFound(QTcpSocket *socket);
-    void sendMethodNotAllowed(QTcpSocket *socket);
-    void sendBadRequest(QTcpSocket *socket);
 
     void broadcastState();
-    void sendState(QWebSocket *socket);
     QByteArray buildStateMessage() const;
+    QByteArray assetTag(const AssetState &asset) const;
+    QByteArray versionTag(quint64 version) const;
+    VirtualOutputAsset snapshotAsset(const AssetState &asset) const;
 
     void setTransition(int transitionType);
     void setBackPixmap(const QPixmap &pixmap, int fillMode);
+    void setBackColor(const QColor &color);
     void setTextPixmap(const QPixmap &pixmap);
+    void setTextImage(const QImage &image);
     void clearMainVideo();
     void updateOverlayAsset();
 
-    QByteArray pixmapToPng(const QPixmap &pixmap) const;
-    QString contentTypeForFile(const QString &path) const;
     QString localFilePath(const QUrl &url) const;
 
     bool m_enabled;
@@ -176,15 +227,29 @@ private:
     QSize m_resolution;
 
     QString m_logoImagePath;
-    QTcpServer *m_httpServer;
-    QWebSocketServer *m_webSocketServer;
-    QSet<QWebSocket*> m_clients;
-    QSet<QTcpSocket*> m_httpSockets;
+    QThread m_networkThread;
+    VirtualOutputServer *m_server;
+    QByteArray m_sessionTag;
     ImageGenerator m_imageGenerator;
 
     AssetState m_backgroundImage;
     AssetState m_textImage;
+    QImage m_lastTextImage;
     AssetState m_overlayImage;
+    // Last background pixmap and a hash of its pixels
+    qint64 m_backgroundPixmapKey;
+    QString m_backgroundContentKey;
+    // Sources of the composited stream
+    QImage m_sceneBackground;
+    int m_sceneBackgroundFill;
+    QImage m_sceneOverlay;
+    int m_streamFrameRate;
+    QCache<QString, EncodedAsset> m_backgroundCache;
+    QColor m_backgroundColor;
+    AssetCodec m_backgroundCodec;
+    AssetCodec m_textCodec;
+    int m_pendingEncodes;
+    bool m_statePending;
     quint64 m_mediaVersion;
     int m_transitionType;
 
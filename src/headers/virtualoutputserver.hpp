@@ -0,0 +1,152 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#ifndef VIRTUALOUTPUTSERVER_HPP
+#define VIRTUALOUTPUTSERVER_HPP
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QMetaType>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+#include <QtWebSockets/QWebSocket>
+#include <QtWebSockets/QWebSocketServer>
+#include "virtualoutputstream.hpp"
+
+struct VirtualOutputAsset
+{
+    QByteArray data;
+    QByteArray contentType;
+    QByteArray tag;
+    QByteArray baseTag;
+    bool available;
+
+    VirtualOutputAsset() : available(false) {}
+};
+
+// Everything the browser clients can see at one moment. Snapshots are never
+// changed after they are handed to the server, the byte arrays are shared.
+struct VirtualOutputSnapshot
+{
+    QByteArray state;
+    VirtualOutputAsset background;
+    VirtualOutputAsset text;
+    VirtualOutputAsset textDelta;
+    VirtualOutputAsset overlay;
+    QString mainVideoPath;
+    QString backgroundVideoPath;
+    VirtualOutputScene scene;
+};
+
+typedef QSharedPointer<const VirtualOutputSnapshot> VirtualOutputSnapshotPtr;
+Q_DECLARE_METATYPE(VirtualOutputSnapshotPtr)
+
+// Serves the virtual output page, assets and media over HTTP and pushes the
+// state to WebSocket clients. Runs on its own thread, see VirtualOutput.
+class VirtualOutputServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VirtualOutputServer(QObject *parent = nullptr);
+    ~VirtualOutputServer();
+
+    static QString contentTypeForFile(const QString &path);
+    // Port the HTTP server listens on, 0 while it is stopped
+    quint16 httpPort() const;
+
+public slots:
+    bool start(int httpPort, int websocketPort);
+    void stop();
+    void publish(VirtualOutputSnapshotPtr snapshot);
+
+private slots:
+    void onNewHttpConnection();
+    void onSocketReadyRead();
+    void onSocketDisconnected();
+    void onSocketBytesWritten();
+    void onNewWebSocketConnection();
+    void onWebSocketDisconnected();
+
+private:
+    // Media bodies are written in chunks as the socket drains instead of
+    // being read into memory whole
+    struct MediaStream
+    {
+        QFile *file;
+        uchar *map;
+        qint64 position;
+        qint64 length;
+
+        MediaStream() : file(nullptr), map(nullptr), position(0), length(0) {}
+    };
+
+    struct StaticFile
+    {
+        QByteArray body;
+        QByteArray contentType;
+        QByteArray etag;
+    };
+
+    void resetHttpSocket(QTcpSocket *socket);
+    void processHttpRequests(QTcpSocket *socket);
+    void handleHttpRequest(QTcpSocket *socket, const QByteArray &requestData);
+    void writeHttpHead(QTcpSocket *socket, const QByteArray &statusLine, const QByteArray &contentType,
+                       const QList<QByteArray> &extraHeaders, qint64 contentLength);
+    void finishHttpResponse(QTcpSocket *socket);
+    void sendHttpResponse(QTcpSocket *socket, const QByteArray &statusLine,
+                          const QByteArray &contentType, const QByteArray &body,
+                          const QList<QByteArray> &extraHeaders = QList<QByteArray>(),
+                          bool sendBody = true, qint64 contentLength = -1);
+    void sendStaticResponse(QTcpSocket *socket, const QString &resource, const QByteArray &contentType,
+                            bool sendBody, const QByteArray &ifNoneMatch);
+    void sendImageResponse(QTcpSocket *socket, const VirtualOutputAsset &asset, const QUrl &url,
+                           bool sendBody, const QByteArray &ifNoneMatch);
+    void sendMediaResponse(QTcpSocket *socket, const QString &filePath, bool sendBody,
+                           const QByteArray &rangeHeader = QByteArray());
+    void startMediaStream(QTcpSocket *socket, const QString &filePath, qint64 start, qint64 length);
+    void pumpMediaStream(QTcpSocket *socket);
+    void finishMediaStream(QTcpSocket *socket);
+    void startFrameStream(QTcpSocket *socket, bool sendBody);
+    void sendNotFound(QTcpSocket *socket);
+    void sendMethodNotAllowed(QTcpSocket *socket);
+    void sendBadRequest(QTcpSocket *socket);
+    void sendState(QWebSocket *socket);
+    void sendInlineAssets(QWebSocket *socket);
+    void sendInlineAsset(QWebSocket *socket, const QByteArray &name, const VirtualOutputAsset &asset);
+    QByteArray assetFrame(const QByteArray &name, const VirtualOutputAsset &asset);
+
+    QTcpServer *m_httpServer;
+    QWebSocketServer *m_webSocketServer;
+    QSet<QWebSocket*> m_clients;
+    // Clients that asked for assets inline, with the tag of each asset they hold
+    QHash<QWebSocket*, QHash<QByteArray, QByteArray> > m_inlineClients;
+    QHash<QByteArray, QByteArray> m_assetFrames;
+    QSet<QTcpSocket*> m_httpSockets;
+    QHash<QTcpSocket*, MediaStream> m_mediaStreams;
+    QHash<QString, StaticFile> m_staticFiles;
+    VirtualOutputStream *m_frameStream;
+    VirtualOutputSnapshotPtr m_snapshot;
+};
+
+#endif // VIRTUALOUTPUTSERVER_HPP
@@ -0,0 +1,110 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#ifndef VIRTUALOUTPUTSTREAM_HPP
+#define VIRTUALOUTPUTSTREAM_HPP
+
+#include <QObject>
+#include <QColor>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QSet>
+#include <QSize>
+#include <QTcpSocket>
+#include <QTimer>
+
+// What the projector shows, as source images. Videos are not part of it,
+// frames show the background color where the browser plays them.
+struct VirtualOutputScene
+{
+    QImage background;
+    int fillMode;
+    QColor color;
+    QImage text;
+    QImage overlay;
+    QSize size;
+    int frameRate;
+    bool fade;
+
+    VirtualOutputScene() : fillMode(0), frameRate(30), fade(false) {}
+    bool sameFrame(const VirtualOutputScene &other) const;
+};
+
+// Composites the scene into a multipart JPEG stream for capture software.
+// One encoder feeds every consumer. Frames are only encoded when the scene
+// changes or a fade is running, the last one is repeated as a keyframe.
+class VirtualOutputStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VirtualOutputStream(QObject *parent = nullptr);
+    ~VirtualOutputStream();
+
+    static QByteArray boundary();
+
+    void setScene(const VirtualOutputScene &scene);
+    void addClient(QTcpSocket *socket);
+    void removeClient(QTcpSocket *socket);
+    bool hasClient(QTcpSocket *socket) const { return m_clients.contains(socket); }
+    void clear();
+
+private slots:
+    void onTick();
+    void onFrameRendered();
+
+private:
+    struct Frame
+    {
+        QImage image;
+        QImage background;
+        QByteArray jpeg;
+    };
+
+    static Frame renderFrame(const VirtualOutputScene &scene, const QImage &background,
+                             const QImage &from, qreal progress);
+    static QImage scaleBackground(const VirtualOutputScene &scene);
+    static QString backgroundKey(const VirtualOutputScene &scene);
+    void renderNext();
+    void sendFrame(const QByteArray &jpeg);
+    void updateTimer();
+
+    QSet<QTcpSocket*> m_clients;
+    VirtualOutputScene m_scene;
+    bool m_dirty;
+
+    // Frame on screen when the current fade started, and the last one rendered
+    QImage m_from;
+    QImage m_shown;
+    QElapsedTimer m_fadeTimer;
+
+    // Background scaled for the stream size, reused until the source changes
+    QImage m_scaledBackground;
+    QString m_scaledBackgroundKey;
+    QString m_renderingBackgroundKey;
+
+    QByteArray m_lastFrame;
+    QElapsedTimer m_sinceLastFrame;
+    QTimer m_timer;
+    QFutureWatcher<Frame> m_watcher;
+    bool m_rendering;
+};
+
+#endif // VIRTUALOUTPUTSTREAM_HPP
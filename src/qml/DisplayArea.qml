@@ -18,6 +18,7 @@
 ***************************************************************************/
 
 import QtQuick
+import QtQuick.Effects
 import QtMultimedia
 
 Rectangle {
@@ -150,6 +151,26 @@ Rectangle {
     {
         id: textImage1
         objectName: "textImage1"
+
+        // Where ImageGenerator laid the text out, the image only covers the text
+        property int baseX: 0
+        property int baseY: 0
+
+        // Drop shadow drawn on the GPU, when the text image was generated without it
+        property bool shadowEnabled: false
+        property color shadowColor: "black"
+        property real shadowOffset: 0
+        property real shadowBlurRadius: 0
+        layer.enabled: shadowEnabled
+        layer.effect: MultiEffect
+        {
+            shadowEnabled: true
+            shadowColor: textImage1.shadowColor
+            shadowHorizontalOffset: textImage1.shadowOffset
+            shadowVerticalOffset: textImage1.shadowOffset
+            blurMax: 32
+            shadowBlur: Math.min(1.0, textImage1.shadowBlurRadius / blurMax)
+        }
 //        anchors.fill: parent
 //        fillMode: Image.Stretch
 //        anchors.centerIn: parent
@@ -167,6 +188,26 @@ Rectangle {
     {
         id: textImage2
         objectName: "textImage2"
+
+        // Where ImageGenerator laid the text out, the image only covers the text
+        property int baseX: 0
+        property int baseY: 0
+
+        // Drop shadow drawn on the GPU, when the text image was generated without it
+        property bool shadowEnabled: false
+        property color shadowColor: "black"
+        property real shadowOffset: 0
+        property real shadowBlurRadius: 0
+        layer.enabled: shadowEnabled
+        layer.effect: MultiEffect
+        {
+            shadowEnabled: true
+            shadowColor: textImage2.shadowColor
+            shadowHorizontalOffset: textImage2.shadowOffset
+            shadowVerticalOffset: textImage2.shadowOffset
+            blurMax: 32
+            shadowBlur: Math.min(1.0, textImage2.shadowBlurRadius / blurMax)
+        }
 //        anchors.fill: parent
 //        fillMode: Image.Stretch
 //        anchors.centerIn: parent
@@ -353,14 +394,14 @@ Rectangle {
         id:moveTextX1to2
         running:false
         NumberAnimation { target: textImage1; property: "x"; to: mTox; duration: tranTime;}
-        NumberAnimation { target: textImage2; property: "x"; to: mx; duration: tranTime;}
+        NumberAnimation { target: textImage2; property: "x"; to: textImage2.baseX; duration: tranTime;}
     }
 
     ParallelAnimation
     {
         id:moveTextX2to1
         running:false
-        NumberAnimation { target: textImage1; property: "x"; to: mx; duration: tranTime;}
+        NumberAnimation { target: textImage1; property: "x"; to: textImage1.baseX; duration: tranTime;}
         NumberAnimation { target: textImage2; property: "x"; to: mTox; duration: tranTime;}
     }
 
@@ -369,14 +410,14 @@ Rectangle {
         id:moveTextY1to2
         running:false
         NumberAnimation { target: textImage1; property: "y"; to: mToy; duration: tranTime;}
-        NumberAnimation { target: textImage2; property: "y"; to: my; duration: tranTime;}
+        NumberAnimation { target: textImage2; property: "y"; to: textImage2.baseY; duration: tranTime;}
     }
 
     ParallelAnimation
     {
         id:moveTextY2to1
         running:false
-        NumberAnimation { target: textImage1; property: "y"; to: my; duration: tranTime;}
+        NumberAnimation { target: textImage1; property: "y"; to: textImage1.baseY; duration: tranTime;}
         NumberAnimation { target: textImage2; property: "y"; to: mToy; duration: tranTime;}
     }
 
@@ -443,58 +484,65 @@ Rectangle {
         parBackFade2to1.stop()
     }
 
+    // Puts a text image where ImageGenerator laid it out
+    function placeText(image)
+    {
+        image.x = image.baseX
+        image.y = image.baseY
+    }
+
     function transitionText1to2(tranType)
     {
+        // The incoming text starts at or slides to its own layout position,
+        // the outgoing one leaves from where it is
         if(tranType === 1)
         {
+            placeText(textImage2)
             textImage2.opacity = 0.0
             parFade1to2.start()
         }
         else if(tranType === 2)
         {
+            placeText(textImage2)
             textImage2.opacity = 0.0
             seqFade1to2.start()
         }
         else if(tranType === 3)
         {
-            mTox = mx + parent.width
-            textImage1.y = my
-            textImage1.x = mx
-            textImage2.y = my
-            textImage2.x = mx - parent.width
+            placeText(textImage1)
+            mTox = textImage1.baseX + parent.width
+            textImage2.y = textImage2.baseY
+            textImage2.x = textImage2.baseX - parent.width
             textImage1.opacity = 1.0
             textImage2.opacity = 1.0
             moveTextX1to2.start()
         }
         else if(tranType === 4)
         {
-            mTox = mx - parent.width
-            textImage1.y = my
-            textImage1.x = mx
-            textImage2.y = my
-            textImage2.x = mx + parent.width
+            placeText(textImage1)
+            mTox = textImage1.baseX - parent.width
+            textImage2.y = textImage2.baseY
+            textImage2.x = textImage2.baseX + parent.width
             textImage1.opacity = 1.0
             textImage2.opacity = 1.0
             moveTextX1to2.start()
         }
         else if(tranType === 5)
         {
-            mToy = my - parent.height
-            textImage1.y = my
-            textImage1.x = mx
-            textImage2.y = my + parent.height
-            textImage2.x = mx
+            placeText(textImage1)
+            mToy = textImage1.baseY - parent.height
+            textImage2.y = textImage2.baseY + parent.height
+            textImage2.x = textImage2.baseX
             textImage1.opacity = 1.0
             textImage2.opacity = 1.0
             moveTextY1to2.start()
         }
         else if(tranType === 6)
         {
-            mToy = my + parent.height
-            textImage1.y = my
-            textImage1.x = mx
-            textImage2.y = my - parent.height
-            textImage2.x = mx
+            placeText(textImage1)
+            mToy = textImage1.baseY + parent.height
+            textImage2.y = textImage2.baseY - parent.height
+            textImage2.x = textImage2.baseX
             textImage1.opacity = 1.0
             textImage2.opacity = 1.0
             moveTextY1to2.start()
@@ -513,67 +561,65 @@ Rectangle {
         {
             textImage1.opacity = 0.0
             textImage2.opacity = 1.0
-            textImage1.x = parent.x
-            textImage1.y = parent.y
-            textImage2.x = parent.x
-            textImage2.y = parent.y
+            placeText(textImage1)
+            placeText(textImage2)
         }
     }
 
     function transitionText2to1(tranType)
     {
+        // The incoming text starts at or slides to its own layout position,
+        // the outgoing one leaves from where it is
         if(tranType === 1)
         {
+            placeText(textImage1)
             textImage1.opacity = 0.0
             parFade2to1.start()
         }
         else if(tranType === 2)
         {
+            placeText(textImage1)
             textImage1.opacity = 0.0
             seqFade2to1.start()
         }
         else if(tranType === 3)
         {
-            mTox = mx + parent.width
-            textImage1.y = my
-            textImage1.x = mx - parent.width
-            textImage2.y = my
-            textImage2.x = mx
-            textImage1.opacity = 1.0
+            placeText(textImage2)
+            mTox = textImage2.baseX + parent.width
+            textImage1.y = textImage1.baseY
+            textImage1.x = textImage1.baseX - parent.width
             textImage2.opacity = 1.0
+            textImage1.opacity = 1.0
             moveTextX2to1.start()
         }
         else if(tranType === 4)
         {
-            mTox = mx - parent.width
-            textImage1.y = my
-            textImage1.x = mx + parent.width
-            textImage2.y = my
-            textImage2.x = mx
-            textImage1.opacity = 1.0
+            placeText(textImage2)
+            mTox = textImage2.baseX - parent.width
+            textImage1.y = textImage1.baseY
+            textImage1.x = textImage1.baseX + parent.width
             textImage2.opacity = 1.0
+            textImage1.opacity = 1.0
             moveTextX2to1.start()
         }
         else if(tranType === 5)
         {
-            mToy = my - parent.height
-            textImage1.y = my + parent.height
-            textImage1.x = mx
-            textImage2.y = my
-            textImage2.x = mx
-            textImage1.opacity = 1.0
+            placeText(textImage2)
+            mToy = textImage2.baseY - parent.height
+            textImage1.y = textImage1.baseY + parent.height
+            textImage1.x = textImage1.baseX
             textImage2.opacity = 1.0
+            textImage1.opacity = 1.0
             moveTextY2to1.start()
         }
         else if(tranType === 6)
         {
-            mToy = my + parent.height
-            textImage1.y = my - parent.height
-            textImage1.x = mx
-            textImage2.y = my
-            textImage2.x = mx
-            textImage1.opacity = 1.0
+            placeText(textImage2)
+            mToy = textImage2.baseY + parent.height
+            textImage1.y = textImage1.baseY - parent.height
+            textImage1.x = textImage1.baseX
             textImage2.opacity = 1.0
+            textImage1.opacity = 1.0
             moveTextY2to1.start()
         }
         else if(tranType === "rotate")
@@ -588,12 +634,10 @@ Rectangle {
         }
         else
         {
-            textImage1.opacity = 1.0
             textImage2.opacity = 0.0
-            textImage1.x = parent.x
-            textImage1.y = parent.y
-            textImage2.x = parent.x
-            textImage2.y = parent.y
+            textImage1.opacity = 1.0
+            placeText(textImage1)
+            placeText(textImage2)
         }
     }
 
@@ -24,12 +24,18 @@ QT += core \
     network \
     websockets \
     sql \
+    concurrent \
     qml \
     quick \
     printsupport \
     multimedia \
     multimediawidgets
 
+# DisplayArea.qml uses Qt 6 QML imports and MultiEffect from QtQuick.Effects
+!versionAtLeast(QT_VERSION, 6.5.0) {
+    error("softProjector needs Qt 6.5 or later, found $${QT_VERSION}")
+}
+
 TARGET = SoftProjector
 TEMPLATE = app
 CONFIG += x86 ppc x86_64 ppc64 # Compile a universal build
@@ -53,6 +59,7 @@ SOURCES += sources/main.cpp \
     sources/editwidget.cpp \
     sources/song.cpp \
     sources/bible.cpp \
+    sources/biblesearchindex.cpp \
     sources/settingsdialog.cpp \
     sources/aboutdialog.cpp \
     sources/addsongbookdialog.cpp \
@@ -78,6 +85,9 @@ SOURCES += sources/main.cpp \
     sources/videoplayerwidget.cpp \
     sources/videoinfo.cpp \
     sources/spfunctions.cpp \
+    sources/songsearchindex.cpp \
+    sources/sqlstatementcache.cpp \
+    sources/databaseindexes.cpp \
     sources/slideshoweditor.cpp \
     sources/editannouncementdialog.cpp \
     sources/announcement.cpp \
@@ -88,9 +98,12 @@ SOURCES += sources/main.cpp \
     sources/displaysetting.cpp \
     sources/projectordisplayscreen.cpp \
     sources/imagegenerator.cpp \
+    sources/fastblur.cpp \
     sources/spimageprovider.cpp \
     sources/mediacontrol.cpp \
     sources/virtualoutput.cpp \
+    sources/virtualoutputserver.cpp \
+    sources/virtualoutputstream.cpp \
     sources/virtualoutputsettingwidget.cpp
 HEADERS += headers/softprojector.hpp \
     headers/songwidget.hpp \
@@ -98,6 +111,7 @@ HEADERS += headers/softprojector.hpp \
     headers/editwidget.hpp \
     headers/song.hpp \
     headers/bible.hpp \
+    headers/biblesearchindex.hpp \
     headers/settingsdialog.hpp \
     headers/aboutdialog.hpp \
     headers/addsongbookdialog.hpp \
@@ -123,6 +137,9 @@ HEADERS += headers/softprojector.hpp \
     headers/videoplayerwidget.hpp \
     headers/videoinfo.hpp \
     headers/spfunctions.hpp \
+    headers/songsearchindex.hpp \
+    headers/sqlstatementcache.hpp \
+    headers/databaseindexes.hpp \
     headers/slideshoweditor.hpp \
     headers/editannouncementdialog.hpp \
     headers/announcement.hpp \
@@ -133,9 +150,12 @@ HEADERS += headers/softprojector.hpp \
     headers/displaysetting.hpp \
     headers/projectordisplayscreen.hpp \
     headers/imagegenerator.hpp \
+    headers/fastblur.hpp \
     headers/spimageprovider.hpp \
     headers/mediacontrol.hpp \
     headers/virtualoutput.hpp \
+    headers/virtualoutputserver.hpp \
+    headers/virtualoutputstream.hpp \
     headers/virtualoutputsettingwidget.hpp
 FORMS += ui/softprojector.ui \
     ui/songwidget.ui \
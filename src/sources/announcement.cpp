@@ -176,16 +176,18 @@ AnnounceModel::AnnounceModel()
 
 void AnnounceModel::setAnnoucements(QList<Announcement> announcements)
 {
-    emit layoutAboutToBeChanged();
-    announceList.clear();
+    beginResetModel();
     announceList = announcements;
-    emit layoutChanged();
+    rowById.clear();
+    updateRows(0);
+    endResetModel();
 }
 
 void AnnounceModel::addAnnouncement(Announcement announce)
 {
     beginInsertRows(QModelIndex(), rowCount(),rowCount());
     announceList.append(announce);
+    rowById.insert(announce.idNum, announceList.count()-1);
     endInsertRows();
 }
 
@@ -240,34 +242,34 @@ bool AnnounceModel::removeRows(int row, int count, const QModelIndex &parent)
 {
     beginRemoveRows(parent,row,row+count-1);
     for(int i=row+count-1; i>=row;i--)
+    {
+        rowById.remove(announceList.at(i).idNum);
         announceList.removeAt(i);
+    }
+    updateRows(row);
     endRemoveRows();
     return true;
 }
 
-void AnnounceModel::emitLayoutChanged()
+void AnnounceModel::updateRows(int from)
 {
-    emit layoutChanged();
+    for(int i=from; i<announceList.count(); ++i)
+        rowById.insert(announceList.at(i).idNum, i);
 }
 
-void AnnounceModel::emitLayoutAboutToBeChanged()
+int AnnounceModel::rowForAnnounce(int annId) const
 {
-    emit layoutAboutToBeChanged();
+    return rowById.value(annId, -1);
 }
 
 void AnnounceModel::updateAnnounceFromDatabase(int annId)
 {
-    emit layoutAboutToBeChanged();
-    for(int i=0; i<announceList.count(); ++i)
-    {
-        Announcement *ann = (Announcement*)&(announceList.at(i));
-        if(ann->idNum == annId)
-        {
-            ann->readData();
-            emit layoutChanged();
-            return;
-        }
-    }
+    int row = rowForAnnounce(annId);
+    if(row < 0)
+        return;
+
+    announceList[row].readData();
+    emit dataChanged(index(row,0), index(row,columnCount()-1));
 }
 
 //void AnnounceModel::updateAnnounceFromDatabase(int newAnnId, int oldAnnId)
@@ -275,12 +277,9 @@ void AnnounceModel::updateAnnounceFromDatabase(int annId)
 //    // TODO: do if needed
 //}
 
-bool AnnounceModel::isInTable(int annId)
+bool AnnounceModel::isInTable(int annId) const
 {
-    foreach(Announcement agent, announceList)
-        if(agent.idNum == annId)
-            return true;
-    return false;
+    return rowById.contains(annId);
 }
 
 AnnounceProxyModel::AnnounceProxyModel(QObject *parent) : QSortFilterProxyModel(parent)
@@ -295,6 +294,7 @@ void AnnounceProxyModel::setFilterString(QString new_string, bool new_match_begi
     filterString = new_string;
     matchExact = new_exact_match;
     matchBeginning = new_match_beginning;
+    invalidateFilter();
 }
 
 bool AnnounceProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
@@ -159,7 +159,7 @@ void AnnounceWidget::deleteAnnouncement()
         previewAnnounce = Announcement();
         ui->listWidgetAnnouncement->clear();
         ui->labelAnnounceTitle->clear();
-        int row = ui->tableViewAnnouncements->currentIndex().row();
+        int row = announceProxy->mapToSource(ui->tableViewAnnouncements->currentIndex()).row();
         announceModel->removeRow(row);
     }
 }
@@ -167,7 +167,14 @@ void AnnounceWidget::deleteAnnouncement()
 void AnnounceWidget::addNewAnnouncement(Announcement announce)
 {
     announceModel->addAnnouncement(announce);
-    ui->tableViewAnnouncements->selectRow(announceModel->rowCount()-1);
+    // The view is sorted, so look up where the new row ended up
+    QModelIndex proxyIndex = announceProxy->mapFromSource(
+                announceModel->index(announceModel->rowForAnnounce(announce.idNum),0));
+    if(proxyIndex.isValid())
+    {
+        ui->tableViewAnnouncements->selectRow(proxyIndex.row());
+        ui->tableViewAnnouncements->scrollTo(proxyIndex);
+    }
 }
 
 void AnnounceWidget::updateAnnouncement()
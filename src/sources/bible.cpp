@@ -17,7 +17,10 @@
 //
 ***************************************************************************/
 
+#include <algorithm>
+#include <QtConcurrent>
 #include "../headers/bible.hpp"
+#include "../headers/sqlstatementcache.hpp"
 
 Bible::Bible()
 {
@@ -33,19 +36,22 @@ QString Bible::getBibleName()
 {
     if(bibleId.isEmpty())
         return "";
-    QSqlQuery sq;
-    sq.exec("SELECT bible_name FROM BibleVersions WHERE id = "+ bibleId );
+    QSqlQuery &sq = SqlStatementCache::query("SELECT bible_name FROM BibleVersions WHERE id = ?");
+    sq.addBindValue(bibleId);
+    SqlStatementCache::exec(sq);
     sq.first();
     QString b = sq.value(0).toString().trimmed();
+    sq.finish();
     return b;
 }
 
 void Bible::retrieveBooks()
 {
     BibleBook book;
-    QSqlQuery sq;
     books.clear();
-    sq.exec("SELECT book_name, id, chapter_count FROM BibleBooks WHERE bible_id = "+ bibleId );
+    QSqlQuery &sq = SqlStatementCache::query("SELECT book_name, id, chapter_count FROM BibleBooks WHERE bible_id = ?");
+    sq.addBindValue(bibleId);
+    SqlStatementCache::exec(sq);
     while (sq.next())
     {
         book.book = sq.value(0).toString().trimmed();
@@ -53,6 +59,7 @@ void Bible::retrieveBooks()
         book.chapterCount = sq.value(2).toInt();
         books.append(book);
     }
+    sq.finish();
 }
 
 QStringList Bible::getBooks()
@@ -85,38 +92,24 @@ void Bible::getVerseRef(QString vId, QString &book, int &chapter, int &verse)
     if(vId.contains(","))
         vId = vId.split(",").first();
 
-    foreach(const BibleVerse &bv, operatorBible)
-    {
-        if(bv.verseId == vId)
-        {
-            book = QString::number(bv.book);
-            chapter = bv.chapter;
-            verse = bv.verseNumber;
-        }
-    }
+    int i = operatorBible.indexOf(vId);
+    if(i < 0)
+        return;
 
-    foreach (const BibleBook bk, books)
-    {
-        if(bk.bookId == book)
-            book = bk.book;
-    }
+    chapter = operatorBible.chapters.at(i);
+    verse = operatorBible.verseNumbers.at(i);
+    book = getBookName(operatorBible.books.at(i));
 }
 
 int Bible::getVerseNumberLast(QString vId)
 {
-    int vernum(0);
     if(vId.contains(","))
         vId = vId.split(",").last();
 
-    foreach(const BibleVerse &bv, operatorBible)
-    {
-        if(bv.verseId == vId)
-        {
-            vernum = bv.verseNumber;
-            break;
-        }
-    }
-    return vernum;
+    int i = operatorBible.indexOf(vId);
+    if(i < 0)
+        return 0;
+    return operatorBible.verseNumbers.at(i);
 }
 
 int Bible::getCurrentBookRow(QString book)
@@ -137,36 +130,37 @@ QStringList Bible::getChapter(int book, int chapter)
 {
     QString verseText, id;
     int verse(0), verse_old(0);
+    int first(0), last(0);
 
     previewIdList.clear();
     verseList.clear();
-    foreach (const BibleVerse &bv,operatorBible)
+    if(!operatorBible.chapterRange(book, chapter, first, last))
+        return verseList;
+
+    for(int i(first); i<last; ++i)
     {
-        if(bv.book == book && bv.chapter == chapter)
+        verse = operatorBible.verseNumbers.at(i);
+        if(verse==verse_old)
         {
-            verse  = bv.verseNumber;
-            if(verse==verse_old)
-            {
-                verseText = verseText.simplified() + " " + bv.verseText;
-                id += "," + bv.verseId;
-                verseList.removeLast();
-                previewIdList.removeLast();
-            }
-            else
-            {
-                verseText = bv.verseText;
-                id = bv.verseId;
-            }
-            verseList << QString::number(verse) + ". " + verseText;
-            previewIdList << id;
-            verse_old = verse;
+            verseText = verseText.simplified() + " " + operatorBible.verseTexts.at(i);
+            id += "," + operatorBible.verseIds.at(i);
+            verseList.removeLast();
+            previewIdList.removeLast();
+        }
+        else
+        {
+            verseText = operatorBible.verseTexts.at(i);
+            id = operatorBible.verseIds.at(i);
         }
+        verseList << QString::number(verse) + ". " + verseText;
+        previewIdList << id;
+        verse_old = verse;
     }
 
     return verseList;
 }
 
-Verse Bible::getCurrentVerseAndCaption(QList<int>  currentRows, BibleSettings& sets, BibleVersionSettings &bv)
+QString Bible::currentVerseIds(const QList<int> &currentRows)
 {
     QString verse_id;
     for(int i(0);i<currentRows.count();++i)
@@ -174,29 +168,58 @@ Verse Bible::getCurrentVerseAndCaption(QList<int>  currentRows, BibleSettings& s
         verse_id += currentIdList.at(currentRows.at(i)) + ",";
     }
     verse_id.chop(1);
+    return verse_id;
+}
+
+Verse Bible::getCurrentVerseAndCaption(QList<int>  currentRows, BibleSettings& sets, BibleVersionSettings &bv)
+{
+    QString verse_id = currentVerseIds(currentRows);
 
     Verse v;
 
     // get primary verse
-    getVerseAndCaption(v.primary_text,v.primary_caption,verse_id,bv.primaryBible,sets.useAbbriviation);
+    getCachedVerseAndCaption(v.primary_text,v.primary_caption,verse_id,bv.primaryBible,sets.useAbbriviation);
 
     // get secondary verse
     if(bv.primaryBible!=bv.secondaryBible && bv.secondaryBible!="none")
-        getVerseAndCaption(v.secondary_text,v.secondary_caption,verse_id,bv.secondaryBible,sets.useAbbriviation);
+        getCachedVerseAndCaption(v.secondary_text,v.secondary_caption,verse_id,bv.secondaryBible,sets.useAbbriviation);
 
     // get trinary versse
     if(bv.trinaryBible!=bv.primaryBible && bv.trinaryBible!=bv.secondaryBible && bv.trinaryBible!="none")
-        getVerseAndCaption(v.trinary_text,v.trinary_caption,verse_id,bv.trinaryBible,sets.useAbbriviation);
+        getCachedVerseAndCaption(v.trinary_text,v.trinary_caption,verse_id,bv.trinaryBible,sets.useAbbriviation);
 
     return v;
 }
 
+void Bible::clearVerseCache()
+{
+    verseCache.clear();
+}
+
+void Bible::getCachedVerseAndCaption(QString &verse, QString &caption, const QString &verId, QString &bibId, bool useAbbr)
+{
+    QString key = QString("%1|%2|%3").arg(verId).arg(bibId).arg(useAbbr);
+    QHash<QString,QPair<QString,QString> >::const_iterator it = verseCache.constFind(key);
+    if(it != verseCache.constEnd())
+    {
+        verse = it.value().first;
+        caption = it.value().second;
+        return;
+    }
+
+    getVerseAndCaption(verse, caption, verId, bibId, useAbbr);
+
+    // Verses are small, but do not let the cache grow without a limit over a long session
+    if(verseCache.count() >= 2048)
+        verseCache.clear();
+    verseCache.insert(key, qMakePair(verse, caption));
+}
+
 void Bible::getVerseAndCaption(QString& verse, QString& caption, QString verId, QString& bibId, bool useAbbr)
 {
     QString verse_old, verse_show, verse_n, verse_nold, verse_nfirst, chapter;
     QString book;
     QStringList ids;
-    QSqlQuery sq;
 
     // clean old verses
     verse.clear();
@@ -205,9 +228,15 @@ void Bible::getVerseAndCaption(QString& verse, QString& caption, QString verId,
     if (verId.contains(","))// Run if more than one database verse items exist or show muliple verses
     {
         ids = verId.split(",");
-        verId.replace(",", "' OR verse_id = '");
-        sq.exec("SELECT book,chapter,verse,verse_text FROM BibleVerse WHERE ( verse_id = '"
-                + verId +"' ) AND bible_id = " + bibId);
+        // One cached statement per number of verse ids
+        QString marks = QString("?,").repeated(ids.count());
+        marks.chop(1);
+        QSqlQuery &sq = SqlStatementCache::query("SELECT book,chapter,verse,verse_text FROM BibleVerse WHERE verse_id IN ("
+                                                 + marks + ") AND bible_id = ? ORDER BY book, chapter, verse, rowid");
+        foreach(const QString &id, ids)
+            sq.addBindValue(id);
+        sq.addBindValue(bibId);
+        SqlStatementCache::exec(sq);
         while (sq.next())
         {
             book = sq.value(0).toString();
@@ -258,34 +287,43 @@ void Bible::getVerseAndCaption(QString& verse, QString& caption, QString verId,
             verse_old = verse;
             verse_nold = verse_n;
         }
+        sq.finish();
         verse = verse_show.simplified();
     }
     else // Run as standard single verse item from database
     {
-        sq.exec("SELECT book,chapter,verse,verse_text FROM BibleVerse WHERE verse_id = '"
-                +verId+"' AND bible_id = " + bibId);
+        QSqlQuery &sq = SqlStatementCache::query("SELECT book,chapter,verse,verse_text FROM BibleVerse "
+                                                 "WHERE verse_id = ? AND bible_id = ?");
+        sq.addBindValue(verId);
+        sq.addBindValue(bibId);
+        SqlStatementCache::exec(sq);
 
         sq.first();
         verse = sq.value(3).toString().trimmed();// Remove the empty line at the end using .trimmed()
 
         book = sq.value(0).toString();
         caption =" " + sq.value(1).toString() + ":" + sq.value(2).toString();
-        sq.clear();
+        sq.finish();
     }
 
     // Add book name to caption
-    sq.exec("SELECT book_name FROM BibleBooks WHERE id = "
-            + book + " AND bible_id = " + bibId);
-    sq.first();
-    caption = sq.value(0).toString() + caption;
-    sq.clear();
+    QSqlQuery &bsq = SqlStatementCache::query("SELECT book_name FROM BibleBooks WHERE id = ? AND bible_id = ?");
+    bsq.addBindValue(book);
+    bsq.addBindValue(bibId);
+    SqlStatementCache::exec(bsq);
+    bsq.first();
+    caption = bsq.value(0).toString() + caption;
+    bsq.finish();
 
     // Add bible abbreveation if to to use it
     if(useAbbr)
     {
-        sq.exec("SELECT abbreviation FROM BibleVersions WHERE id = " + bibId);
-        sq.first();
-        QString abr = sq.value(0).toString().trimmed();
+        QSqlQuery &asq = SqlStatementCache::query("SELECT abbreviation FROM BibleVersions WHERE id = ?");
+        asq.addBindValue(bibId);
+        SqlStatementCache::exec(asq);
+        asq.first();
+        QString abr = asq.value(0).toString().trimmed();
+        asq.finish();
         if (!abr.isEmpty())
             caption = QString("%1 (%2)").arg(caption).arg(abr);
     }
@@ -294,133 +332,122 @@ void Bible::getVerseAndCaption(QString& verse, QString& caption, QString verId,
     caption = caption.simplified();
 }
 
-QList<BibleSearch> Bible::searchBible(bool allWords, QRegularExpression searchExp)
+QList<BibleSearch> Bible::searchBible(int type, QStringList words, QRegularExpression searchExp)
 {   ///////// Search entire Bible //////////
-
-    QList<BibleSearch> return_results;
-
-    QString sw = searchExp.pattern();
-    sw.remove("\\b(");
-    sw.remove(")\\b");
-
-    foreach(const BibleVerse &bv,operatorBible)
-    {
-        if(bv.verseText.contains(searchExp))
-        {
-            if(allWords)
-            {
-                QStringList stl = sw.split("|");
-                bool hasAll = false;
-                for (int j(0);j<stl.count();++j)
-                {
-                    hasAll = bv.verseText.contains(QRegularExpression("\\b"+stl.at(j)+"\\b",QRegularExpression::CaseInsensitiveOption));
-                    if(!hasAll)
-                        break;
-                }
-                if(hasAll)
-                    addSearchResult(bv,return_results);
-            }
-            else
-                addSearchResult(bv,return_results);
-        }
-
-    }
-
-    return return_results;
+    return searchRange(type, words, searchExp, 0, operatorBible.count());
 }
 
-QList<BibleSearch> Bible::searchBible(bool allWords, QRegularExpression searchExp, int book)
+QList<BibleSearch> Bible::searchBible(int type, QStringList words, QRegularExpression searchExp, int book)
 {   ///////// Search in selected book //////////
+    int first(0), last(0);
+    if(!operatorBible.bookRange(book, first, last))
+        return QList<BibleSearch>();
+    return searchRange(type, words, searchExp, first, last);
+}
 
+QList<BibleSearch> Bible::searchBible(int type, QStringList words, QRegularExpression searchExp, int book, int chapter)
+{   ///////// Search in selected chapter //////////
+    int first(0), last(0);
+    if(!operatorBible.chapterRange(book, chapter, first, last))
+        return QList<BibleSearch>();
+    return searchRange(type, words, searchExp, first, last);
+}
+
+QList<BibleSearch> Bible::searchRange(int type, const QStringList &words, const QRegularExpression &searchExp, int first, int last)
+{
+    // Search types: 0 - phrase, 1 - whole word phrase, 2 - beginning of verse,
+    // 3 - any of the words, 4 - all of the words
     QList<BibleSearch> return_results;
+    if(first >= last || words.isEmpty())
+        return return_results;
 
-    QString sw = searchExp.pattern();
-    sw.remove("\\b(");
-    sw.remove(")\\b");
+    // Whole word expressions are compiled once per search, they are used
+    // to check "all words" matches and to rank "any word" matches
+    QList<QRegularExpression> wordExps;
+    if(type == 3 || type == 4)
+    {
+        foreach(const QString &w, words)
+            wordExps.append(QRegularExpression("\\b"+w+"\\b",QRegularExpression::CaseInsensitiveOption));
+    }
 
-    foreach(const BibleVerse &bv,operatorBible)
+    // Narrow down candidate verses using the inverted index. If it is still being
+    // built in the background, fall back to checking every verse in range.
+    QVector<int> candidates;
+    if(isSearchIndexReady())
     {
-        if(bv.verseText.contains(searchExp) && bv.book == book)
+        for(int i(0); i<words.count(); ++i)
         {
-            if(allWords)
-            {
-                QStringList stl = sw.split("|");
-                bool hasAll = false;
-                for (int j(0);j<stl.count();++j)
-                {
-                    hasAll = bv.verseText.contains(QRegularExpression("\\b"+stl.at(j)+"\\b",QRegularExpression::CaseInsensitiveOption));
-                    if(!hasAll)
-                        break;
-                }
-                if(hasAll)
-                    addSearchResult(bv,return_results);
-            }
+            QVector<int> postings = searchIndex.lookup(words.at(i));
+            if(i == 0)
+                candidates = postings;
+            else if(type == 3)
+                candidates = BibleSearchIndex::unite(candidates, postings);
             else
-                addSearchResult(bv,return_results);
+                candidates = BibleSearchIndex::intersect(candidates, postings);
         }
+        QVector<int>::const_iterator lo = std::lower_bound(candidates.constBegin(), candidates.constEnd(), first);
+        QVector<int>::const_iterator hi = std::lower_bound(lo, candidates.constEnd(), last);
+        candidates = QVector<int>(lo, hi);
+    }
+    else
+    {
+        candidates.reserve(last - first);
+        for(int i(first); i<last; ++i)
+            candidates.append(i);
     }
 
-    return return_results;
-}
-
-QList<BibleSearch> Bible::searchBible(bool allWords, QRegularExpression searchExp, int book, int chapter)
-{   ///////// Search in selected chapter //////////
-
-    QList<BibleSearch> return_results;
-
-    QString sw = searchExp.pattern();
-    sw.remove("\\b(");
-    sw.remove(")\\b");
-
-    foreach(const BibleVerse &bv,operatorBible)
+    // Verify candidates with the actual search expression
+    QList<QPair<int,int> > hits; // (verse index, number of matched words)
+    foreach(int i, candidates)
     {
-        if(bv.verseText.contains(searchExp) && bv.book == book && bv.chapter == chapter)
+        const QString &verseText = operatorBible.verseTexts.at(i);
+        if(!verseText.contains(searchExp))
+            continue;
+
+        int matched(0);
+        for(int j(0); j<wordExps.count(); ++j)
         {
-            if(allWords)
-            {
-                QStringList stl = sw.split("|");
-                bool hasAll = false;
-                for (int j(0);j<stl.count();++j)
-                {
-                    hasAll = bv.verseText.contains(QRegularExpression("\\b"+stl.at(j)+"\\b",QRegularExpression::CaseInsensitiveOption));
-                    if(!hasAll)
-                        break;
-                }
-                if(hasAll)
-                    addSearchResult(bv,return_results);
-            }
-            else
-                addSearchResult(bv,return_results);
+            if(verseText.contains(wordExps.at(j)))
+                ++matched;
+            else if(type == 4)
+                break;
         }
+        if(type == 4 && matched < wordExps.count())
+            continue;
+        hits.append(qMakePair(i, matched));
     }
 
+    // Verses matching more of the words come first, otherwise keep Bible order
+    if(type == 3)
+        std::stable_sort(hits.begin(), hits.end(), [](const QPair<int,int> &a, const QPair<int,int> &b)
+        {
+            return a.second > b.second;
+        });
+
+    for(int i(0); i<hits.count(); ++i)
+        addSearchResult(hits.at(i).first, return_results);
+
     return return_results;
 }
 
-void Bible::addSearchResult(const BibleVerse &bv, QList<BibleSearch> &bsl)
+void Bible::addSearchResult(int index, QList<BibleSearch> &bsl)
 {
     BibleSearch  results;
-    foreach (const BibleBook &bk,books)
-    {
-        if(bk.bookId == QString::number(bv.book))
-        {
-            results.book = bk.book;
-            break;
-        }
-    }
-    results.chapter = QString::number(bv.chapter);
-    results.verse = QString::number(bv.verseNumber);
-    results.verse_text = QString("%1 %2:%3 %4").arg(results.book).arg(results.chapter).arg(results.verse).arg(bv.verseText);
+    results.book = getBookName(operatorBible.books.at(index));
+    results.chapter = QString::number(operatorBible.chapters.at(index));
+    results.verse = QString::number(operatorBible.verseNumbers.at(index));
+    results.verse_text = QString("%1 %2:%3 %4").arg(results.book).arg(results.chapter).arg(results.verse).arg(operatorBible.verseTexts.at(index));
 
     bsl.append(results);
 }
 
-void Bible::loadOperatorBible()
+void Bible::loadOperatorBible(bool withSearchIndex)
 {
-    operatorBible.clear();
+    QList<BibleVerse> verses;
     BibleVerse bv;
-    QSqlQuery sq;
-    sq.exec("SELECT verse_id, book, chapter, verse, verse_text FROM BibleVerse WHERE bible_id = '"+bibleId+"'");
+    QSqlQuery &sq = SqlStatementCache::query("SELECT verse_id, book, chapter, verse, verse_text FROM BibleVerse WHERE bible_id = ?");
+    sq.addBindValue(bibleId);
+    SqlStatementCache::exec(sq);
     while(sq.next())
     {
         bv.verseId = sq.value(0).toString().trimmed();
@@ -428,6 +455,108 @@ void Bible::loadOperatorBible()
         bv.chapter = sq.value(2).toInt();
         bv.verseNumber = sq.value(3).toInt();
         bv.verseText = sq.value(4).toString().trimmed();
-        operatorBible.append(bv);
+        verses.append(bv);
+    }
+    sq.finish();
+    operatorBible.build(verses);
+
+    // Build the search index in the background, searches fall back
+    // to scanning verses until it is ready
+    searchIndex = BibleSearchIndex();
+    searchIndexFuture = QFuture<BibleSearchIndex>();
+    if(withSearchIndex)
+        searchIndexFuture = QtConcurrent::run(&BibleSearchIndex::build, bibleId, operatorBible.verseTexts);
+}
+
+bool Bible::isSearchIndexReady()
+{
+    if(searchIndex.isEmpty() && searchIndexFuture.isValid() && searchIndexFuture.isFinished())
+    {
+        searchIndex = searchIndexFuture.result();
+        searchIndexFuture = QFuture<BibleSearchIndex>();
+    }
+    return !searchIndex.isEmpty();
+}
+
+void BibleVerseStore::clear()
+{
+    verseIds.clear();
+    books.clear();
+    chapters.clear();
+    verseNumbers.clear();
+    verseTexts.clear();
+    idIndex.clear();
+    chapterIndex.clear();
+    bookIndex.clear();
+}
+
+void BibleVerseStore::build(QList<BibleVerse> &verses)
+{
+    clear();
+
+    // Stable sort keeps database order for split verses sharing one verse number
+    std::stable_sort(verses.begin(), verses.end(), [](const BibleVerse &a, const BibleVerse &b)
+    {
+        if(a.book != b.book)
+            return a.book < b.book;
+        if(a.chapter != b.chapter)
+            return a.chapter < b.chapter;
+        return a.verseNumber < b.verseNumber;
+    });
+
+    int n = verses.count();
+    verseIds.reserve(n);
+    books.reserve(n);
+    chapters.reserve(n);
+    verseNumbers.reserve(n);
+    verseTexts.reserve(n);
+    idIndex.reserve(n);
+
+    for(int i(0); i<n; ++i)
+    {
+        const BibleVerse &bv = verses.at(i);
+        verseIds.append(bv.verseId);
+        books.append(bv.book);
+        chapters.append(bv.chapter);
+        verseNumbers.append(bv.verseNumber);
+        verseTexts.append(bv.verseText);
+        if(!idIndex.contains(bv.verseId))
+            idIndex.insert(bv.verseId, i);
+
+        quint32 ck = chapterKey(bv.book, bv.chapter);
+        if(i == 0 || books.at(i-1) != bv.book || chapters.at(i-1) != bv.chapter)
+            chapterIndex.insert(ck, qMakePair(i, i+1));
+        else
+            chapterIndex[ck].second = i+1;
+
+        if(i == 0 || books.at(i-1) != bv.book)
+            bookIndex.insert(bv.book, qMakePair(i, i+1));
+        else
+            bookIndex[bv.book].second = i+1;
     }
 }
+
+int BibleVerseStore::indexOf(const QString &verseId) const
+{
+    return idIndex.value(verseId, -1);
+}
+
+bool BibleVerseStore::chapterRange(int book, int chapter, int &first, int &last) const
+{
+    QHash<quint32,QPair<int,int> >::const_iterator it = chapterIndex.constFind(chapterKey(book, chapter));
+    if(it == chapterIndex.constEnd())
+        return false;
+    first = it.value().first;
+    last = it.value().second;
+    return true;
+}
+
+bool BibleVerseStore::bookRange(int book, int &first, int &last) const
+{
+    QHash<int,QPair<int,int> >::const_iterator it = bookIndex.constFind(book);
+    if(it == bookIndex.constEnd())
+        return false;
+    first = it.value().first;
+    last = it.value().second;
+    return true;
+}
@@ -0,0 +1,221 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include <algorithm>
+#include "../headers/biblesearchindex.hpp"
+
+// Increase when index file layout changes
+static const quint32 indexMagic = 0x53504249; // "SPBI"
+static const quint32 indexVersion = 1;
+
+// Substrings up to this length are mapped to the tokens holding them
+static const int gramLength = 3;
+
+// Searched words remembered before the lookup cache starts over
+static const int lookupCacheLimit = 512;
+
+BibleSearchIndex::BibleSearchIndex()
+{
+}
+
+BibleSearchIndex BibleSearchIndex::build(QString bibleId, QVector<QString> verseTexts)
+{
+    // Runs on a worker thread, so only touches its own copies of the data
+    BibleSearchIndex index;
+    index.stamp = makeStamp(verseTexts);
+
+    QString fileName = cacheFileName(bibleId);
+    if(!fileName.isEmpty() && index.load(fileName, index.stamp))
+    {
+        index.buildGrams();
+        return index;
+    }
+
+    for(int i(0); i<verseTexts.count(); ++i)
+    {
+        foreach(const QString &token, tokenize(verseTexts.at(i)))
+        {
+            QVector<int> &list = index.postings[token];
+            // A verse is listed only once per token
+            if(list.isEmpty() || list.last() != i)
+                list.append(i);
+        }
+    }
+
+    if(!fileName.isEmpty())
+        index.save(fileName);
+    index.buildGrams();
+    return index;
+}
+
+void BibleSearchIndex::buildGrams()
+{
+    // Derived from postings, so not part of the index file
+    words.clear();
+    words.reserve(postings.count());
+    for(QHash<QString,QVector<int> >::const_iterator it = postings.constBegin(); it != postings.constEnd(); ++it)
+        words.append(it.key());
+
+    grams.clear();
+    for(int k(0); k<words.count(); ++k)
+    {
+        const QString &word = words.at(k);
+        for(int length(1); length<=gramLength; ++length)
+        {
+            for(int i(0); i+length<=word.length(); ++i)
+            {
+                QVector<int> &list = grams[word.mid(i, length)];
+                if(list.isEmpty() || list.last() != k)
+                    list.append(k);
+            }
+        }
+    }
+}
+
+QStringList BibleSearchIndex::tokenize(const QString &text)
+{
+    // Tokens are runs of letters, digits and underscores. This is a superset of
+    // what "\w" matches, so every regex hit lies within an indexed token.
+    QStringList tokens;
+    QString token;
+    for(int i(0); i<text.length(); ++i)
+    {
+        QChar c = text.at(i);
+        if(c.isLetterOrNumber() || c == QLatin1Char('_') || c.isMark())
+            token.append(c);
+        else if(!token.isEmpty())
+        {
+            tokens.append(token.toCaseFolded());
+            token.clear();
+        }
+    }
+    if(!token.isEmpty())
+        tokens.append(token.toCaseFolded());
+    return tokens;
+}
+
+QVector<int> BibleSearchIndex::lookup(const QString &word) const
+{
+    // Returns verses that contain the word anywhere inside a token, which covers
+    // phrase, whole word and beginning-of-verse searches. Callers verify the
+    // candidates with the actual search expression.
+    QString w = word.toCaseFolded();
+    QHash<QString,QVector<int> >::const_iterator cached = lookupCache.constFind(w);
+    if(cached != lookupCache.constEnd())
+        return cached.value();
+
+    // Short words are substrings themselves. Longer ones can only be inside
+    // tokens that hold all of their trigrams, those are checked for the word.
+    QVector<int> candidates;
+    if(w.length() <= gramLength)
+        candidates = grams.value(w);
+    else
+    {
+        candidates = grams.value(w.left(gramLength));
+        for(int i(1); i+gramLength<=w.length() && !candidates.isEmpty(); ++i)
+            candidates = intersect(candidates, grams.value(w.mid(i, gramLength)));
+    }
+
+    QVector<int> result;
+    foreach(int k, candidates)
+    {
+        if(words.at(k).contains(w))
+            result += postings.value(words.at(k));
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+
+    if(lookupCache.count() >= lookupCacheLimit)
+        lookupCache.clear();
+    lookupCache.insert(w, result);
+    return result;
+}
+
+QVector<int> BibleSearchIndex::intersect(const QVector<int> &a, const QVector<int> &b)
+{
+    QVector<int> result;
+    result.reserve(qMin(a.count(), b.count()));
+    std::set_intersection(a.constBegin(), a.constEnd(), b.constBegin(), b.constEnd(), std::back_inserter(result));
+    return result;
+}
+
+QVector<int> BibleSearchIndex::unite(const QVector<int> &a, const QVector<int> &b)
+{
+    QVector<int> result;
+    result.reserve(a.count() + b.count());
+    std::set_union(a.constBegin(), a.constEnd(), b.constBegin(), b.constEnd(), std::back_inserter(result));
+    return result;
+}
+
+QString BibleSearchIndex::cacheFileName(const QString &bibleId)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(dir.isEmpty() || bibleId.isEmpty() || !QDir().mkpath(dir))
+        return QString();
+    return QString("%1/bible_%2.idx").arg(dir).arg(bibleId);
+}
+
+QByteArray BibleSearchIndex::makeStamp(const QVector<QString> &verseTexts)
+{
+    // Identifies the exact text the index was built from, so that edited or
+    // re-imported Bibles never use a stale index file
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    foreach(const QString &text, verseTexts)
+    {
+        hash.addData(text.toUtf8());
+        hash.addData(QByteArray(1, '\0'));
+    }
+    return hash.result();
+}
+
+bool BibleSearchIndex::load(const QString &fileName, const QByteArray &expectedStamp)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic(0), version(0);
+    QByteArray fileStamp;
+    in >> magic >> version;
+    if(magic != indexMagic || version != indexVersion)
+        return false;
+    in >> fileStamp;
+    if(fileStamp != expectedStamp)
+        return false;
+
+    QHash<QString,QVector<int> > p;
+    in >> p;
+    if(in.status() != QDataStream::Ok)
+        return false;
+
+    postings = p;
+    return true;
+}
+
+void BibleSearchIndex::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out << indexMagic << indexVersion << stamp << postings;
+    file.commit();
+}
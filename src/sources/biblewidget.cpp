@@ -331,6 +331,7 @@ void BibleWidget::on_search_button_clicked()
     int type = ui->comboBoxSearchType->currentIndex();
     int range = ui->comboBoxSearchRange->currentIndex();
 
+    QStringList search_words = search_text.split(" ");
     QRegularExpression rx, rxh;
     rx.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
     search_text.replace(" ","\\W*");
@@ -363,12 +364,12 @@ void BibleWidget::on_search_button_clicked()
     highlight->highlighter->setHighlightText(rxh.pattern()); // set highlighting rule
 
     if(range == 0) // Search entire Bible
-        search_results = bible.searchBible((type == 4),rx);
+        search_results = bible.searchBible(type,search_words,rx);
     else if(range == 1) // Search current book only
-        search_results = bible.searchBible((type == 4),rx,
+        search_results = bible.searchBible(type,search_words,rx,
                                            bible.books.at(bible.getCurrentBookRow(ui->listBook->currentItem()->text())).bookId.toInt());
     else if (range == 2) // Search current chapter only
-        search_results = bible.searchBible((type == 4),rx,
+        search_results = bible.searchBible(type,search_words,rx,
                                            bible.books.at(bible.getCurrentBookRow(ui->listBook->currentItem()->text())).bookId.toInt(),
                                            ui->listChapterNum->currentItem()->text().toInt());
 
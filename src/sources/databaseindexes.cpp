@@ -0,0 +1,60 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include "../headers/databaseindexes.hpp"
+
+void createDatabaseIndexes()
+{
+    // Indexes for the queries that run on every slide or list load
+    QSqlQuery sq;
+    sq.exec("CREATE INDEX IF NOT EXISTS 'idx_BibleVerse_bible_verse' ON 'BibleVerse' ('bible_id', 'verse_id')");
+    sq.exec("CREATE INDEX IF NOT EXISTS 'idx_BibleVerse_bible_book' ON 'BibleVerse' ('bible_id', 'book', 'chapter', 'verse')");
+    sq.exec("CREATE INDEX IF NOT EXISTS 'idx_BibleBooks_bible_id' ON 'BibleBooks' ('bible_id', 'id')");
+    sq.exec("CREATE INDEX IF NOT EXISTS 'idx_Songs_songbook_number' ON 'Songs' ('songbook_id', 'number')");
+    sq.exec("CREATE INDEX IF NOT EXISTS 'idx_Slides_ss_order' ON 'Slides' ('ss_id', 'p_order')");
+    QStringList themeTables = {"ThemeAnnounce", "ThemeBible", "ThemePassive", "ThemeSong"};
+    for (const QString &tableName : themeTables)
+        sq.exec(QString("CREATE INDEX IF NOT EXISTS 'idx_%1_theme_disp' ON '%1' ('theme_id', 'disp')").arg(tableName));
+}
+
+bool migrateDatabaseForIndexes()
+{
+    QSqlQuery sq;
+
+    // BibleVerse stored numeric ids as TEXT. Rebuild the table with INTEGER affinity
+    // so that the ids compare as numbers and the indexes below can be used.
+    QSqlDatabase::database().transaction();
+    bool ok = sq.exec("CREATE TABLE 'BibleVerse_new' ('verse_id' TEXT, 'bible_id' INTEGER, 'book' INTEGER, "
+                      "'chapter' INTEGER, 'verse' INTEGER, 'verse_text' TEXT)");
+    ok = ok && sq.exec("INSERT INTO BibleVerse_new (verse_id, bible_id, book, chapter, verse, verse_text) "
+                       "SELECT TRIM(verse_id), CAST(TRIM(bible_id) AS INTEGER), CAST(TRIM(book) AS INTEGER), "
+                       "chapter, verse, verse_text FROM BibleVerse");
+    ok = ok && sq.exec("DROP TABLE BibleVerse");
+    ok = ok && sq.exec("ALTER TABLE BibleVerse_new RENAME TO BibleVerse");
+    if (ok) {
+        QSqlDatabase::database().commit();
+    } else {
+        qWarning() << "Failed to normalize BibleVerse ids:" << sq.lastError().text();
+        QSqlDatabase::database().rollback();
+    }
+
+    createDatabaseIndexes();
+    sq.exec("ANALYZE");
+    return ok;
+}
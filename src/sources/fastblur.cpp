@@ -0,0 +1,250 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include "../headers/fastblur.hpp"
+#include <QAtomicInt>
+#include <QtMath>
+#include <QVector>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FASTBLUR_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is compiled in with a target attribute and picked at run time
+#if defined(FASTBLUR_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define FASTBLUR_AVX2
+#define FASTBLUR_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+// Running sums are kept in 16 bits, which holds 255 * (2 * 127 + 1)
+static const int maxBoxRadius = 127;
+
+static QAtomicInt forcedImplementation(FastBlur::Automatic);
+
+static int boxRadius(int radius)
+{
+    // Three box passes of width w approximate a Gaussian with variance
+    // 3 * (w * w - 1) / 12. The blur radius is taken as two sigmas.
+    if(radius < 1)
+        return 0;
+    int r = qRound((qSqrt(qreal(radius) * radius + 1) - 1) / 2);
+    return qBound(1, r, maxBoxRadius);
+}
+
+// Each pass blurs <lines> lines of <len> pixels. Pixels of a line are
+// <ps> apart and lines start <ls> apart, so the same code does rows and
+// columns. Pixels outside of the line are treated as transparent.
+// Output is (sum * mul) >> 16 for every channel in all implementations.
+
+// Spreads the four channels of a pixel into 16 bit fields, so one 64 bit
+// add updates all running sums at once
+static inline quint64 expandPixel(quint32 p)
+{
+    return quint64(p & 0x000000ff) | (quint64(p & 0x0000ff00) << 8)
+            | (quint64(p & 0x00ff0000) << 16) | (quint64(p & 0xff000000) << 24);
+}
+
+static void boxPassScalar(const quint32 *src, quint32 *dst, int len, int lines, int ps, int ls, int r, quint32 mul)
+{
+    for(int line(0); line < lines; ++line)
+    {
+        const quint32 *s = src + line * ls;
+        quint32 *d = dst + line * ls;
+        quint64 sum(0);
+        for(int i(0); i < r && i < len; ++i)
+            sum += expandPixel(s[i * ps]);
+        for(int i(0); i < len; ++i)
+        {
+            if(i + r < len)
+                sum += expandPixel(s[(i + r) * ps]);
+            d[i * ps] = (((quint32(sum) & 0xffff) * mul) >> 16)
+                    | ((((quint32(sum >> 16) & 0xffff) * mul) >> 16) << 8)
+                    | ((((quint32(sum >> 32) & 0xffff) * mul) >> 16) << 16)
+                    | ((((quint32(sum >> 48) & 0xffff) * mul) >> 16) << 24);
+            if(i - r >= 0)
+                sum -= expandPixel(s[(i - r) * ps]);
+        }
+    }
+}
+
+#if defined(FASTBLUR_SSE2)
+// Two lines at a time, 8 channels in 16 bit lanes
+static inline __m128i loadSse2(const quint32 *p, int ls)
+{
+    __m128i v = _mm_unpacklo_epi32(_mm_cvtsi32_si128(int(p[0])), _mm_cvtsi32_si128(int(p[ls])));
+    return _mm_unpacklo_epi8(v, _mm_setzero_si128());
+}
+
+static inline void storeSse2(quint32 *p, int ls, __m128i v)
+{
+    v = _mm_packus_epi16(v, v);
+    p[0] = quint32(_mm_cvtsi128_si32(v));
+    p[ls] = quint32(_mm_cvtsi128_si32(_mm_srli_si128(v, 4)));
+}
+
+static int boxPassSse2(const quint32 *src, quint32 *dst, int len, int lines, int ps, int ls, int r, quint32 mul)
+{
+    const __m128i vmul = _mm_set1_epi16(short(mul));
+    int line(0);
+    for(; line + 2 <= lines; line += 2)
+    {
+        const quint32 *s = src + line * ls;
+        quint32 *d = dst + line * ls;
+        __m128i sum = _mm_setzero_si128();
+        for(int i(0); i < r && i < len; ++i)
+            sum = _mm_add_epi16(sum, loadSse2(s + i * ps, ls));
+        for(int i(0); i < len; ++i)
+        {
+            if(i + r < len)
+                sum = _mm_add_epi16(sum, loadSse2(s + (i + r) * ps, ls));
+            storeSse2(d + i * ps, ls, _mm_mulhi_epu16(sum, vmul));
+            if(i - r >= 0)
+                sum = _mm_sub_epi16(sum, loadSse2(s + (i - r) * ps, ls));
+        }
+    }
+    return line;
+}
+#endif
+
+#if defined(FASTBLUR_AVX2)
+// Four lines at a time, 16 channels in 16 bit lanes
+FASTBLUR_AVX2_TARGET static inline __m256i loadAvx2(const quint32 *p, int ls)
+{
+    __m128i v;
+    if(ls == 1)
+        v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    else
+        v = _mm_set_epi32(int(p[3 * ls]), int(p[2 * ls]), int(p[ls]), int(p[0]));
+    return _mm256_cvtepu8_epi16(v);
+}
+
+FASTBLUR_AVX2_TARGET static inline void storeAvx2(quint32 *p, int ls, __m256i v)
+{
+    __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    if(ls == 1)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+        return;
+    }
+    p[0] = quint32(_mm_cvtsi128_si32(packed));
+    p[ls] = quint32(_mm_cvtsi128_si32(_mm_srli_si128(packed, 4)));
+    p[2 * ls] = quint32(_mm_cvtsi128_si32(_mm_srli_si128(packed, 8)));
+    p[3 * ls] = quint32(_mm_cvtsi128_si32(_mm_srli_si128(packed, 12)));
+}
+
+FASTBLUR_AVX2_TARGET static int boxPassAvx2(const quint32 *src, quint32 *dst, int len, int lines, int ps, int ls, int r, quint32 mul)
+{
+    const __m256i vmul = _mm256_set1_epi16(short(mul));
+    int line(0);
+    for(; line + 4 <= lines; line += 4)
+    {
+        const quint32 *s = src + line * ls;
+        quint32 *d = dst + line * ls;
+        __m256i sum = _mm256_setzero_si256();
+        for(int i(0); i < r && i < len; ++i)
+            sum = _mm256_add_epi16(sum, loadAvx2(s + i * ps, ls));
+        for(int i(0); i < len; ++i)
+        {
+            if(i + r < len)
+                sum = _mm256_add_epi16(sum, loadAvx2(s + (i + r) * ps, ls));
+            storeAvx2(d + i * ps, ls, _mm256_mulhi_epu16(sum, vmul));
+            if(i - r >= 0)
+                sum = _mm256_sub_epi16(sum, loadAvx2(s + (i - r) * ps, ls));
+        }
+    }
+    return line;
+}
+
+static bool hasAvx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+static void boxPass(const quint32 *src, quint32 *dst, int len, int lines, int ps, int ls, int r, quint32 mul)
+{
+    int implementation = forcedImplementation.loadRelaxed();
+    int done(0);
+#if defined(FASTBLUR_AVX2)
+    if((implementation == FastBlur::Automatic && hasAvx2()) || implementation == FastBlur::Avx2)
+        done = boxPassAvx2(src, dst, len, lines, ps, ls, r, mul);
+#endif
+#if defined(FASTBLUR_SSE2)
+    if(done == 0 && (implementation == FastBlur::Automatic || implementation == FastBlur::Sse2))
+        done = boxPassSse2(src, dst, len, lines, ps, ls, r, mul);
+#endif
+    // Lines left over from the vector loops
+    boxPassScalar(src + done * ls, dst + done * ls, len, lines - done, ps, ls, r, mul);
+}
+
+bool FastBlur::setImplementation(Implementation implementation)
+{
+    bool available = (implementation == Automatic || implementation == Scalar);
+#if defined(FASTBLUR_SSE2)
+    available = available || implementation == Sse2;
+#endif
+#if defined(FASTBLUR_AVX2)
+    available = available || (implementation == Avx2 && hasAvx2());
+#endif
+    if(available)
+        forcedImplementation.storeRelaxed(implementation);
+    return available;
+}
+
+int FastBlur::extent(int radius)
+{
+    return 3 * boxRadius(radius);
+}
+
+void FastBlur::blurPremultiplied(QImage &image, const QRect &rect, int radius)
+{
+    int r = boxRadius(radius);
+    if(r < 1 || image.isNull())
+        return;
+    if(image.format() != QImage::Format_ARGB32_Premultiplied)
+        image.convertTo(QImage::Format_ARGB32_Premultiplied);
+
+    int spread = 3 * r;
+    QRect area = rect.adjusted(-spread, -spread, spread, spread).intersected(image.rect());
+    if(area.isEmpty())
+        return;
+
+    int w = area.width();
+    int h = area.height();
+    QVector<quint32> a(w * h), b(w * h);
+    for(int y(0); y < h; ++y)
+        memcpy(a.data() + y * w, image.constScanLine(area.top() + y) + area.left() * 4, w * 4);
+
+    quint32 mul = (65536 + r) / (2 * r + 1);
+
+    // Rows, then columns
+    boxPass(a.constData(), b.data(), w, h, 1, w, r, mul);
+    boxPass(b.constData(), a.data(), w, h, 1, w, r, mul);
+    boxPass(a.constData(), b.data(), w, h, 1, w, r, mul);
+    boxPass(b.constData(), a.data(), h, w, w, 1, r, mul);
+    boxPass(a.constData(), b.data(), h, w, w, 1, r, mul);
+    boxPass(b.constData(), a.data(), h, w, w, 1, r, mul);
+
+    for(int y(0); y < h; ++y)
+        memcpy(image.scanLine(area.top() + y) + area.left() * 4, a.constData() + y * w, w * 4);
+}
@@ -18,15 +18,46 @@
 ***************************************************************************/
 
 #include "../headers/imagegenerator.hpp"
+#include <QCryptographicHash>
+#include <QtMath>
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include "../headers/fastblur.hpp"
 
+// Default memory budget of the render cache in megabytes
+static const int defaultRenderCacheBudget = 96;
 
 ImageGenerator::ImageGenerator()
 {
     m_type = 0;
     m_shadow = m_blurShadow = false;
+    m_bibleAddBKColorToText = m_songAddBKColorToText = m_announcementAddBKColorToText = false;
     m_shadowOffset = 3;
     m_blurRadius = 5;
+    m_deferShadow = false;
     m_screenSize = QSize(1280,960);
+    m_cacheHits = m_cacheMisses = m_cacheEvictions = 0;
+    m_fitLayouts = m_prerendered = 0;
+    m_blurNanoseconds = m_blurCount = 0;
+    setRenderCacheBudget(defaultRenderCacheBudget);
+}
+
+void ImageGenerator::setRenderCacheBudget(int megabytes)
+{
+    m_renderCache.setMaxCost(qMax(0, megabytes) * 1024);
+}
+
+QString ImageGenerator::renderCacheStatistics() const
+{
+    // Every cache miss renders one slide, so this also gives text layouts per slide
+    return QString("Render cache: %1 hits, %2 misses, %3 evictions, %4 images using %5 of %6 KB; "
+                   "%7 text layouts, %8 per rendered slide; %9 rendered ahead; "
+                   "%10 shadow blurs, %11 ms each")
+            .arg(m_cacheHits).arg(m_cacheMisses).arg(m_cacheEvictions)
+            .arg(m_renderCache.count()).arg(m_renderCache.totalCost()).arg(m_renderCache.maxCost())
+            .arg(m_fitLayouts).arg(m_cacheMisses ? double(m_fitLayouts) / m_cacheMisses : 0.0, 0, 'f', 1)
+            .arg(m_prerendered)
+            .arg(m_blurCount).arg(m_blurCount ? m_blurNanoseconds / 1e6 / m_blurCount : 0.0, 0, 'f', 2);
 }
 
 void ImageGenerator::setScreenSize(QSize size)
@@ -63,7 +94,7 @@ QPixmap ImageGenerator::generateColorImage(QColor &color)
     return pmap;
 }
 
-QPixmap ImageGenerator::generateBibleImage(Verse verse, BibleSettings &bSets)
+void ImageGenerator::prepareBibleText(Verse verse, BibleSettings &bSets)
 {
     m_type = 1;
     m_verse = verse;
@@ -83,10 +114,9 @@ QPixmap ImageGenerator::generateBibleImage(Verse verse, BibleSettings &bSets)
     m_bibleTextGenBKColor = m_bSets.bibleTextGenBKColor;
 
     m_isTextPrepared = false;
-    return renderText();
 }
 
-QPixmap ImageGenerator::generateSongImage(Stanza stanza, SongSettings &sSets)
+void ImageGenerator::prepareSongText(Stanza stanza, SongSettings &sSets)
 {
     m_type = 2;
     m_stanza = stanza;
@@ -105,10 +135,9 @@ QPixmap ImageGenerator::generateSongImage(Stanza stanza, SongSettings &sSets)
     m_songTextGenBKColor = m_sSets.songTextGenBKColor;
 
     m_isTextPrepared = false;
-    return renderText();
 }
 
-QPixmap ImageGenerator::generateAnnounceImage(AnnounceSlide announce, TextSettings &aSets)
+void ImageGenerator::prepareAnnounceText(AnnounceSlide announce, TextSettings &aSets)
 {
     m_type = 3;
     m_announce = announce;
@@ -121,13 +150,195 @@ QPixmap ImageGenerator::generateAnnounceImage(AnnounceSlide announce, TextSettin
     m_blurShadow = m_aSets.useBlurShadow;
 
     m_isTextPrepared = false;
+}
+
+QImage ImageGenerator::generateBibleImage(Verse verse, BibleSettings &bSets)
+{
+    prepareBibleText(verse, bSets);
     return renderText();
+}
+
+QImage ImageGenerator::generateSongImage(Stanza stanza, SongSettings &sSets)
+{
+    prepareSongText(stanza, sSets);
+    return renderText();
+}
+
+QImage ImageGenerator::generateAnnounceImage(AnnounceSlide announce, TextSettings &aSets)
+{
+    prepareAnnounceText(announce, aSets);
+    return renderText();
+}
+
+void ImageGenerator::prerenderBibleImage(Verse verse, BibleSettings &bSets)
+{
+    QSharedPointer<ImageGenerator> job = createPrerenderJob();
+    job->prepareBibleText(verse, bSets);
+    schedulePrerender(job);
+}
+
+void ImageGenerator::prerenderSongImage(Stanza stanza, SongSettings &sSets)
+{
+    QSharedPointer<ImageGenerator> job = createPrerenderJob();
+    job->prepareSongText(stanza, sSets);
+    schedulePrerender(job);
+}
+
+void ImageGenerator::prerenderAnnounceImage(AnnounceSlide announce, TextSettings &aSets)
+{
+    QSharedPointer<ImageGenerator> job = createPrerenderJob();
+    job->prepareAnnounceText(announce, aSets);
+    schedulePrerender(job);
+}
+
+QSharedPointer<ImageGenerator> ImageGenerator::createPrerenderJob()
+{
+    // A private generator per job keeps the worker away from this generator's state
+    QSharedPointer<ImageGenerator> job(new ImageGenerator);
+    job->m_screenSize = m_screenSize;
+    job->m_shadowOffset = m_shadowOffset;
+    job->m_blurRadius = m_blurRadius;
+    job->m_deferShadow = m_deferShadow;
+    job->setRenderCacheBudget(0);
+    return job;
+}
+
+void ImageGenerator::schedulePrerender(QSharedPointer<ImageGenerator> job)
+{
+    collectPrerendered();
+
+    // Backgrounds are not part of the text image, and pixmaps belong to the GUI thread
+    job->m_bSets.backgroundPix = QPixmap();
+    job->m_sSets.backgroundPix = QPixmap();
+    job->m_aSets.backgroundPix = QPixmap();
+
+    // Nowhere to keep the result if the render cache is disabled
+    QByteArray key = job->renderCacheKey();
+    if(m_renderCache.maxCost() == 0 || m_renderCache.contains(key) || m_prerenders.contains(key))
+        return;
+
+    m_prerenders.insert(key, QtConcurrent::run(QThreadPool::globalInstance(), [job]() {
+        return job->renderTextUncached();
+    }));
+}
+
+void ImageGenerator::collectPrerendered()
+{
+    // Move finished render-ahead images into the render cache
+    QMutableHashIterator<QByteArray,QFuture<QImage> > it(m_prerenders);
+    while(it.hasNext())
+    {
+        it.next();
+        if(it.value().isFinished())
+        {
+            insertRenderCache(it.key(), it.value().result());
+            ++m_prerendered;
+            it.remove();
+        }
+    }
+}
+
+void ImageGenerator::insertRenderCache(const QByteArray &key, const QImage &image)
+{
+    int cost = qMax(1, int(image.sizeInBytes() / 1024));
+    int countBefore = m_renderCache.count();
+    if(m_renderCache.insert(key, new QImage(image), cost))
+        m_cacheEvictions += countBefore + 1 - m_renderCache.count();
+}
+
+QImage ImageGenerator::renderText()
+{
+    // Chorus repeats and stepping back to earlier verses are common, so reuse
+    // images rendered from the same content and settings when possible
+    collectPrerendered();
+    QByteArray key = renderCacheKey();
+    QImage *cached = m_renderCache.object(key);
+    if(cached)
+    {
+        ++m_cacheHits;
+        return *cached;
+    }
+
+    // The operator got here before the render-ahead finished, wait for it
+    // rather than rendering the same slide twice
+    QHash<QByteArray,QFuture<QImage> >::iterator pending = m_prerenders.find(key);
+    if(pending != m_prerenders.end())
+    {
+        QImage image = pending.value().result();
+        m_prerenders.erase(pending);
+        ++m_cacheHits;
+        ++m_prerendered;
+        insertRenderCache(key, image);
+        return image;
+    }
+    ++m_cacheMisses;
 
+    QImage outMap = renderTextUncached();
+    insertRenderCache(key, outMap);
+    return outMap;
 }
 
-QPixmap ImageGenerator::renderText()
+QByteArray ImageGenerator::renderCacheKey()
 {
-    QPixmap textMap(m_screenSize), shadowMap(m_screenSize), outMap(m_screenSize);
+    // Serialize everything that affects the rendered image and hash it
+    QByteArray data;
+    QDataStream ds(&data, QIODevice::WriteOnly);
+    ds << m_type << m_screenSize << m_shadow << m_blurShadow << m_shadowOffset << m_blurRadius << isShadowDeferred()
+       << m_bibleAddBKColorToText << m_bibleTextRecBKColor << m_bibleTextGenBKColor
+       << m_songAddBKColorToText << m_songTextRecBKColor << m_songTextGenBKColor
+       << m_announcementAddBKColorToText << m_announcementTextRecBKColor << m_announcementTextGenBKColor;
+
+    switch (m_type) {
+    case 1:
+        ds << m_verse.primary_text << m_verse.primary_caption
+           << m_verse.secondary_text << m_verse.secondary_caption
+           << m_verse.trinary_text << m_verse.trinary_caption
+           << m_bSets.versions.primaryBible << m_bSets.versions.secondaryBible << m_bSets.versions.trinaryBible
+           << m_bSets.textFont << m_bSets.textColor << m_bSets.textShadowColor
+           << m_bSets.textAlignmentV << m_bSets.textAlignmentH
+           << m_bSets.captionFont << m_bSets.captionColor << m_bSets.captionShadowColor
+           << m_bSets.captionAlignment << m_bSets.captionPosition
+           << m_bSets.screenUse << m_bSets.screenPosition;
+        break;
+    case 2:
+        ds << m_stanza.number << m_stanza.stanza << m_stanza.stanzaTitle << m_stanza.tune << m_stanza.isLast
+           << m_sSets.textFont << m_sSets.textColor << m_sSets.textShadowColor
+           << m_sSets.textAlignmentV << m_sSets.textAlignmentH
+           << m_sSets.showStanzaTitle << m_sSets.showSongKey << m_sSets.showSongNumber << m_sSets.showSongEnding
+           << m_sSets.infoFont << m_sSets.infoColor << m_sSets.infoShadowColor << m_sSets.infoAling
+           << m_sSets.endingFont << m_sSets.endingColor << m_sSets.endingShadowColor
+           << m_sSets.endingType << m_sSets.endingPosition
+           << m_sSets.screenUse << m_sSets.screenPosition;
+        break;
+    case 3:
+        ds << m_announce.text
+           << m_aSets.textFont << m_aSets.textColor << m_aSets.textAlignmentV << m_aSets.textAlignmentH;
+        break;
+    default:
+        break;
+    }
+
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+QImage ImageGenerator::renderTextUncached()
+{
+    // Only QImage is used here, so render-ahead jobs can run this on a worker thread.
+
+    // Lay the text out on a scratch image first to learn which part of the screen
+    // it covers, then allocate and draw only that part. The returned image has
+    // its position on the screen set as offset().
+    m_textBounds = QRect();
+    QImage scratch(1, 1, QImage::Format_ARGB32_Premultiplied);
+    QPainter scratchPaint(&scratch);
+    drawText(&scratchPaint,false);
+    scratchPaint.end();
+
+    QRect region = textRegion();
+    bool shadow = m_shadow && !isShadowDeferred();
+    QImage textMap(region.size(), QImage::Format_ARGB32_Premultiplied);
+    QImage shadowMap(shadow ? region.size() : QSize(1,1), QImage::Format_ARGB32_Premultiplied);
+    QImage outMap(region.size(), QImage::Format_ARGB32_Premultiplied);
     //fill with transparent background
     if(m_bibleAddBKColorToText == 1 || m_songAddBKColorToText == 1 || m_announcementAddBKColorToText == 1)
     {  
@@ -141,68 +352,133 @@ QPixmap ImageGenerator::renderText()
     outMap.fill(QColor(0,0,0,0));
 
     QPainter textPaint(&textMap), shadowPaint(&shadowMap), outPaint(&outMap);
+    textPaint.translate(-region.topLeft());
+    shadowPaint.translate(-region.topLeft());
     //TODO: remove set paint for shadow and make it as an option in settings.
 
-    // int shadowOffset(0);
-
     // Draw main text
+    drawText(&textPaint,false);
+    if(shadow)
+        drawText(&shadowPaint,true);
+
+    textPaint.end();
+    shadowPaint.end();
+
+
+    // Set the blured image to the produced text image:
+    if(shadow && m_blurShadow) // Blur the shadow, only around the text:
+    {
+        QElapsedTimer blurTimer;
+        blurTimer.start();
+        FastBlur::blurPremultiplied(shadowMap,m_textBounds.translated(-region.topLeft()),m_blurRadius);
+        m_blurNanoseconds += blurTimer.nsecsElapsed();
+        ++m_blurCount;
+    }
+
+    // draw shadow onto output pixmap
+
+    if(shadow)
+        outPaint.drawImage(m_shadowOffset,m_shadowOffset,shadowMap);
+
+    // draw text onto output pixmap
+    outPaint.drawImage(0,0,textMap);
+    outPaint.end();
+
+    outMap.setOffset(region.topLeft());
+    return outMap;
+}
+
+void ImageGenerator::drawText(QPainter *painter, bool isShadow)
+{
     switch (m_type) {
     case 1:
-        // Draw Bible
-        drawBibleText(&textPaint,false);
-        if(m_shadow)
-        {
-            // prepare and draw bible shadow
-            //shadowOffset = (m_bdSets.tFont.pointSize() / 15);
-            drawBibleText(&shadowPaint,true);
-        }
+        drawBibleText(painter,isShadow);
         break;
     case 2:
-        // Draw Song
-        drawSongText(&textPaint,false);
-        if(m_shadow)
-        {
-            // prepare and draw song shadow
-            //shadowOffset = (m_sSets.textFont.pointSize() / 15);
-            drawSongText(&shadowPaint,true);
-        }
+        drawSongText(painter,isShadow);
         break;
     case 3:
-        // Draw Announse
-        drawAnnounceText(&textPaint,false);
-        if(m_shadow)
-        {
-            // prepare and draw announcement shadow
-            //shadowOffset = (m_aSets.textFont.pointSize() / 15);
-            drawAnnounceText(&shadowPaint,true);
-        }
+        drawAnnounceText(painter,isShadow);
         break;
     default:
         break;
     }
+}
 
-    textPaint.end();
-    shadowPaint.end();
+void ImageGenerator::addTextBounds(QPainter *painter, const QRect &drawn)
+{
+    // Layout rects do not cover glyph overhangs, italic and script faces
+    // reach past them by more the larger the font is
+    QFontMetrics metrics(painter->font(), painter->device());
+    int pad = qMax(8, metrics.height() / 4);
+    pad = qMax(pad, qMax(-metrics.minLeftBearing(), -metrics.minRightBearing()));
+    m_textBounds |= drawn.adjusted(-pad,-pad,pad,pad);
+}
 
+QRect ImageGenerator::textRegion()
+{
+    // Part of the screen that the text, its shadow and blur can touch
+    QRect screen(QPoint(0,0), m_screenSize);
+    if(m_bibleAddBKColorToText == 1 || m_songAddBKColorToText == 1 || m_announcementAddBKColorToText == 1)
+        return screen; // Text background color covers everything
 
-    // Set the blured image to the produced text image:
-    if(m_blurShadow) // Blur the shadow:
+    QRect region = m_textBounds;
+    if(m_shadow && !isShadowDeferred())
     {
-        QGraphicsBlurEffect* beff = new QGraphicsBlurEffect;
-        beff->setBlurRadius(m_blurRadius);
-        shadowMap = applyEffectToImage(shadowMap,beff);
+        int spread = m_blurShadow ? FastBlur::extent(m_blurRadius) : 0;
+        region |= region.adjusted(-spread,-spread,spread,spread).translated(m_shadowOffset,m_shadowOffset);
     }
+    region &= screen;
+    if(region.isEmpty())
+        region = QRect(0,0,1,1);
+    return region;
+}
 
-    // draw shadow onto output pixmap
-
-    if(m_shadow || m_blurShadow)
-        outPaint.drawPixmap(m_shadowOffset,m_shadowOffset,shadowMap);
+void ImageGenerator::setDeferShadow(bool defer)
+{
+    m_deferShadow = defer;
+}
 
-    // draw text onto output pixmap
-    outPaint.drawPixmap(0,0,textMap);
-    outPaint.end();
+bool ImageGenerator::textShadow(QColor *color, int *offset, qreal *blurRadius)
+{
+    if(!m_shadow || !isShadowDeferred(color))
+        return false;
+    *offset = m_shadowOffset;
+    *blurRadius = m_blurShadow ? m_blurRadius : 0;
+    return true;
+}
 
-    return outMap;
+bool ImageGenerator::isShadowDeferred(QColor *color)
+{
+    // The GPU draws one shadow from the text alpha, so it can only take over
+    // when every part of the text casts the same shadow color and no text
+    // background is painted into the shadow
+    if(!m_deferShadow || m_bibleAddBKColorToText == 1 || m_songAddBKColorToText == 1
+            || m_announcementAddBKColorToText == 1)
+        return false;
+
+    QColor shadowColor;
+    switch (m_type) {
+    case 1:
+        if(m_bSets.captionShadowColor != m_bSets.textShadowColor)
+            return false;
+        shadowColor = m_bSets.textShadowColor;
+        break;
+    case 2:
+        if(m_sSets.infoShadowColor != m_sSets.textShadowColor
+                || m_sSets.endingShadowColor != m_sSets.textShadowColor)
+            return false;
+        shadowColor = m_sSets.textShadowColor;
+        break;
+    case 3:
+        shadowColor = QColor(Qt::black);
+        break;
+    default:
+        return false;
+    }
+    if(color)
+        *color = shadowColor;
+    return true;
 }
 
 QRect ImageGenerator::boundRectOrDrawText(QPainter *painter, bool draw, int left, int top, int width, int height, int flags, QString text)
@@ -213,7 +489,10 @@ QRect ImageGenerator::boundRectOrDrawText(QPainter *painter, bool draw, int left
 
     QRect out_rect;
     if(draw)
+    {
         painter->drawText(left, top, width, height, flags, text, &out_rect);
+        addTextBounds(painter, out_rect);
+    }
     else
         out_rect = painter->boundingRect(left, top, width, height, flags, text);
     return out_rect;
@@ -321,78 +600,56 @@ void ImageGenerator::drawBibleText(QPainter *painter, bool isShadow)
     else if(m_bSets.captionAlignment==2)
         cflags += Qt::AlignRight;
 
-    bool exit1 = false, exit2 = false, exit3 = false;
     if(!m_isTextPrepared)
     {
         m_bdSets.clear();
-        while(!(exit1 && exit2 && exit3))
-        {
-            if(havePrimary)
-            {
-                // Prepare primary version
-                // Figure out how much space the drawing will take at the current font size:
-                drawBibleTextToRect(painter,trect1,crect1,m_verse.primary_text,m_verse.primary_caption,
-                                    tflags,cflags,top,left,w,maxh);
-
-                // Make sure that all fits into the screen
-                exit1 = ((trect1.height()+crect1.height())<=maxh);
-            }
-            else
-            {
-                exit1 = true;
-            }
 
-            if(haveSecondary)
+        // Find the largest text size at which all translations fit. The caption
+        // shrinks along with the text once the text gets smaller than the caption.
+        const int MIN_FONT_SIZE = 6;
+        int textSize = m_bSets.textFont.pointSize();
+        int capSize = m_bSets.captionFont.pointSize();
+        int measuredSize = -1;
+        bool measuredFits = false;
+        auto measure = [&](int size, bool full) -> bool
+        {
+            m_bSets.textFont.setPointSize(size);
+            m_bSets.captionFont.setPointSize(capSize >= textSize ? capSize - (textSize - size) : qMin(capSize, size));
+            measuredSize = size;
+
+            // Figure out how much space the drawing will take at this font size
+            // and make sure that all fits into the screen
+            drawBibleTextToRect(painter,trect1,crect1,m_verse.primary_text,m_verse.primary_caption,
+                                tflags,cflags,top,left,w,maxh);
+            measuredFits = ((trect1.height()+crect1.height())<=maxh);
+            if(haveSecondary && (measuredFits || full))
             {
-                // Prepare Secondary version
-                // Figure out how much space the drawing will take at the current font size:
                 drawBibleTextToRect(painter,trect2,crect2,m_verse.secondary_text,m_verse.secondary_caption,
                                     tflags,cflags,top2,left,w,maxh);
-
-                // Make sure that all fits into the screen
-                exit2 = ((trect2.height()+crect2.height())<=maxh);
-            }
-            else
-            {
-                exit2 = true;
+                measuredFits = measuredFits && ((trect2.height()+crect2.height())<=maxh);
             }
-
-            if(haveTrinary)
+            if(haveTrinary && (measuredFits || full))
             {
-                // Prepare Trinary version
-                // Figure out how much space the drawing will take at the current font size:
                 drawBibleTextToRect(painter,trect3,crect3,m_verse.trinary_text,m_verse.trinary_caption,
                                     tflags,cflags,top3,left,w,maxh);
-
-                // Make sure that all fits into the screen
-                exit3 = ((trect3.height()+crect3.height())<=maxh);
-            }
-            else
-            {
-                exit3 = true;
+                measuredFits = measuredFits && ((trect3.height()+crect3.height())<=maxh);
             }
-
-            if(!(exit1 && exit2 && exit3)) // The current font is too large, decrease and try again:
-            {
-                int current_size = m_bSets.textFont.pointSize();
-                int curCap_size = m_bSets.captionFont.pointSize();
-                
-                // FIX #5: Add minimum font size check to prevent infinite loops
-                const int MIN_FONT_SIZE = 6;
-                if (current_size <= MIN_FONT_SIZE)
-                {
-                    break;  // Prevent font from becoming too small
-                }
-                
-                current_size--;
-                m_bSets.textFont.setPointSize(current_size);
-                if (curCap_size > current_size)
-                {
-                    curCap_size--;
-                    m_bSets.captionFont.setPointSize(curCap_size);
-                }
-            }
-       }
+            return measuredFits;
+        };
+
+        int estimate = estimatePointSize(m_bSets.textFont, m_verse.primary_text, w, maxh, true);
+        if(haveSecondary)
+            estimate = qMin(estimate, estimatePointSize(m_bSets.textFont, m_verse.secondary_text, w, maxh, true));
+        if(haveTrinary)
+            estimate = qMin(estimate, estimatePointSize(m_bSets.textFont, m_verse.trinary_text, w, maxh, true));
+
+        int size = fitPointSize(qMin(MIN_FONT_SIZE, textSize), textSize, estimate,
+                                [&](int sz) { return measure(sz, false); });
+        if(measuredSize != size || !measuredFits)
+        {
+            ++m_fitLayouts;
+            measure(size, true);
+        }
 
         // FIX #3: Add bounds checking to verify verses fit within allocated sections
         if(havePrimary && (trect1.height() + crect1.height()) > section1_height)
@@ -422,7 +679,18 @@ void ImageGenerator::drawBibleText(QPainter *painter, bool isShadow)
          m_bdSets.cFont = m_bSets.captionFont;
     }
 
+    // Fill the text background behind each translation
+    if(!isShadow && m_bibleAddBKColorToText == 1)
+    {
+        fillBibleTextBackground(painter, m_bdSets.ptRect, m_bdSets.pcRect, top, left, w, maxh);
+        if(haveSecondary)
+            fillBibleTextBackground(painter, m_bdSets.stRect, m_bdSets.scRect, top2, left, w, maxh);
+        if(haveTrinary)
+            fillBibleTextBackground(painter, m_bdSets.ttRect, m_bdSets.tcRect, top3, left, w, maxh);
+    }
+
     // Draw the bible text verse(s) at the final size:
+    QRect drawn;
     // FIX #4: Add safety clipping to prevent verses from exceeding their allocated sections
     painter->setFont(m_bdSets.tFont);
     if(isShadow)
@@ -437,14 +705,16 @@ void ImageGenerator::drawBibleText(QPainter *painter, bool isShadow)
     // Primary verse: clamp height to section1_height
     int primary_text_height = qMin(m_bdSets.ptRect.height(), section1_height - m_bdSets.pcRect.height());
     primary_text_height = qMax(primary_text_height, 0);
-    painter->drawText(left, m_bdSets.ptRect.top(), w, primary_text_height, tflags, m_verse.primary_text);
+    painter->drawText(left, m_bdSets.ptRect.top(), w, primary_text_height, tflags, m_verse.primary_text, &drawn);
+    addTextBounds(painter, drawn);
 
     if(haveSecondary && !m_verse.secondary_text.isEmpty())
     {
         // Secondary verse: clamp height to section2_height
         int secondary_text_height = qMin(m_bdSets.stRect.height(), section2_height - m_bdSets.scRect.height());
         secondary_text_height = qMax(secondary_text_height, 0);
-        painter->drawText(left, m_bdSets.stRect.top(), w, secondary_text_height, tflags, m_verse.secondary_text);
+        painter->drawText(left, m_bdSets.stRect.top(), w, secondary_text_height, tflags, m_verse.secondary_text, &drawn);
+        addTextBounds(painter, drawn);
     }
 
     if(haveTrinary && !m_verse.trinary_text.isEmpty())
@@ -452,7 +722,8 @@ void ImageGenerator::drawBibleText(QPainter *painter, bool isShadow)
         // Tertiary verse: clamp height to section3_height
         int tertiary_text_height = qMin(m_bdSets.ttRect.height(), section3_height - m_bdSets.tcRect.height());
         tertiary_text_height = qMax(tertiary_text_height, 0);
-        painter->drawText(left, m_bdSets.ttRect.top(), w, tertiary_text_height, tflags, m_verse.trinary_text);
+        painter->drawText(left, m_bdSets.ttRect.top(), w, tertiary_text_height, tflags, m_verse.trinary_text, &drawn);
+        addTextBounds(painter, drawn);
     }
 
     painter->setFont(m_bdSets.cFont);
@@ -467,16 +738,19 @@ void ImageGenerator::drawBibleText(QPainter *painter, bool isShadow)
         painter->setPen(m_bSets.captionColor);
     }
 
-    painter->drawText(m_bdSets.pcRect, cflags, m_verse.primary_caption);
+    painter->drawText(m_bdSets.pcRect, cflags, m_verse.primary_caption, &drawn);
+    addTextBounds(painter, drawn);
 
     if(haveSecondary && !m_verse.secondary_text.isEmpty())
     {
-        painter->drawText(m_bdSets.scRect, cflags, m_verse.secondary_caption);
+        painter->drawText(m_bdSets.scRect, cflags, m_verse.secondary_caption, &drawn);
+        addTextBounds(painter, drawn);
     }
 
     if(haveTrinary && !m_verse.trinary_text.isEmpty())
     {
-        painter->drawText(m_bdSets.tcRect, cflags, m_verse.trinary_caption);
+        painter->drawText(m_bdSets.tcRect, cflags, m_verse.trinary_caption, &drawn);
+        addTextBounds(painter, drawn);
     }
 }
 
@@ -492,12 +766,6 @@ void ImageGenerator::drawBibleTextToRect(QPainter *painter, QRect& trect, QRect&
     painter->setFont(m_bSets.textFont);
     trect = painter->boundingRect(left, top, width, height-crect.height(), tflags, ttext);
 
-    if(m_bibleAddBKColorToText == 1)
-    {
-        int fillheight = trect.height()+crect.height();
-        painter->fillRect(QRect(0, top+height-fillheight-left, width+(left*2), top+height), QBrush(m_bibleTextRecBKColor, Qt::SolidPattern));
-    }
-
     // reset capion location
     int ch = crect.height();
     int th = trect.height();
@@ -515,6 +783,114 @@ void ImageGenerator::drawBibleTextToRect(QPainter *painter, QRect& trect, QRect&
     }
 }
 
+void ImageGenerator::fillBibleTextBackground(QPainter *painter, const QRect &trect, const QRect &crect, int top, int left, int width, int height)
+{
+    int fillheight = trect.height()+crect.height();
+    painter->fillRect(QRect(0, top+height-fillheight-left, width+(left*2), top+height), QBrush(m_bibleTextRecBKColor, Qt::SolidPattern));
+}
+
+int ImageGenerator::fitPointSize(int minSize, int maxSize, int estimate, const std::function<bool(int)> &fits)
+{
+    // Returns the largest point size in [minSize, maxSize] for which the text fits,
+    // or minSize if it never does. Starts from the estimate and gallops toward the
+    // answer, then binary searches, so only a handful of layouts are needed.
+    if(maxSize <= minSize)
+    {
+        ++m_fitLayouts;
+        fits(maxSize);
+        return maxSize;
+    }
+
+    int guess = qBound(minSize, estimate, maxSize);
+    int lo, hi; // lo fits, hi does not
+    int step = 1;
+    ++m_fitLayouts;
+    if(fits(guess))
+    {
+        lo = guess;
+        hi = maxSize + 1;
+        while(lo < maxSize)
+        {
+            int next = qMin(maxSize, lo + step);
+            ++m_fitLayouts;
+            if(!fits(next))
+            {
+                hi = next;
+                break;
+            }
+            lo = next;
+            step *= 2;
+        }
+        if(lo == maxSize)
+            return maxSize;
+    }
+    else
+    {
+        hi = guess;
+        lo = minSize - 1;
+        while(hi > minSize)
+        {
+            int next = qMax(minSize, hi - step);
+            ++m_fitLayouts;
+            if(fits(next))
+            {
+                lo = next;
+                break;
+            }
+            hi = next;
+            step *= 2;
+        }
+        if(lo < minSize)
+            return minSize;
+    }
+
+    while(hi - lo > 1)
+    {
+        int mid = lo + (hi - lo) / 2;
+        ++m_fitLayouts;
+        if(fits(mid))
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int ImageGenerator::estimatePointSize(const QFont &font, const QString &text, int width, int height, bool wrap)
+{
+    // Rough point size at which the text would fill the area, based on average glyph
+    // metrics of the font family. Only used as a starting point for fitPointSize().
+    if(text.isEmpty() || width <= 0 || height <= 0)
+        return font.pointSize();
+
+    QString key = QString("%1|%2|%3").arg(font.family()).arg(font.weight()).arg(font.italic());
+    QHash<QString,QPointF>::const_iterator it = m_glyphMetrics.constFind(key);
+    QPointF metrics; // average char width and line spacing at 1 pt
+    if(it != m_glyphMetrics.constEnd())
+        metrics = it.value();
+    else
+    {
+        QFont f(font);
+        f.setPointSize(100);
+        QFontMetricsF fm(f);
+        metrics = QPointF(qMax(qreal(0.01), fm.averageCharWidth() / 100), qMax(qreal(0.01), fm.lineSpacing() / 100));
+        m_glyphMetrics.insert(key, metrics);
+    }
+
+    QStringList lines = text.split("\n");
+    int longest(1);
+    foreach(const QString &line, lines)
+        longest = qMax(longest, line.length());
+
+    qreal byLines = height / (lines.count() * metrics.y());
+    qreal estimate;
+    if(wrap)
+        estimate = qMin(byLines, qSqrt(0.8 * width * height / (text.length() * metrics.x() * metrics.y())));
+    else
+        estimate = qMin(byLines, width / (longest * metrics.x()));
+    return qMax(1, int(estimate));
+}
+
 void ImageGenerator::drawSongText(QPainter *painter, bool isShadow)
 {
     // Draw the text of the current song verse to the specified painter; making
@@ -641,60 +1017,55 @@ void ImageGenerator::drawSongText(QPainter *painter, bool isShadow)
         caph = caption_rect.height();
 
         // Prepare Ending
-        painter->setFont(m_sSets.endingFont);
-        ending_rect = boundRectOrDrawText(painter, false, left, top, width, height, Qt::AlignHCenter | Qt::AlignTop, song_ending);
-
         // Decrease song ending font size so that it would fit in the screen width
-        while(ending_rect.width()> width)
+        auto measureEnding = [&](int size) -> bool
         {
-            m_sSets.endingFont.setPointSize(m_sSets.endingFont.pointSize()-1);
+            m_sSets.endingFont.setPointSize(size);
             painter->setFont(m_sSets.endingFont);
             ending_rect = boundRectOrDrawText(painter, false, left, top, width, height, Qt::AlignHCenter | Qt::AlignTop, song_ending);
+            return ending_rect.width() <= width;
+        };
+        int endingSize = m_sSets.endingFont.pointSize();
+        int fitted = fitPointSize(1, endingSize,
+                                  estimatePointSize(m_sSets.endingFont, song_ending, width, height, false), measureEnding);
+        if(m_sSets.endingFont.pointSize() != fitted)
+        {
+            ++m_fitLayouts;
+            measureEnding(fitted);
         }
         endh = ending_rect.height();
 
         // Prepare Main Text
-        painter->setFont(main_font);
-        main_rect = boundRectOrDrawText(painter, false, left, top, width, height, main_flags, main_text);
-
-        mainh = main_rect.height();
-        mainw = main_rect.width();
-        totalh = caph+endh+mainh;
-
         // Decrease song text to fit the screen
-        while(mainw > width || totalh > height)
+        int measuredSize = -1;
+        bool measuredFits = false;
+        auto measureMain = [&](int size) -> bool
         {
-            main_font.setPointSize(main_font.pointSize() - 1);
+            main_font.setPointSize(size);
             painter->setFont(main_font);
             main_rect = boundRectOrDrawText(painter, false, left, top, width, height, main_flags, main_text);
             mainh = main_rect.height();
             mainw = main_rect.width();
             totalh = caph+endh+mainh;
-        }
+            measuredSize = size;
+            measuredFits = !(mainw > width || totalh > height);
+            return measuredFits;
+        };
+        int textSize = m_sSets.textFont.pointSize();
+        fitted = fitPointSize(1, textSize,
+                              estimatePointSize(main_font, main_text, width, height-caph-endh, false), measureMain);
 
         // Check if main font is less then 4/5 of original. if so, then song preparation again with text wrap
-        if(main_font.pointSize() <(m_sSets.textFont.pointSize()*4/5))
+        if(fitted < (textSize*4/5))
         {
             main_flags += Qt::TextWordWrap;
-            main_font = m_sSets.textFont;
-
-            // Prepare Main Text
-            painter->setFont(m_sSets.textFont);
-            main_rect = boundRectOrDrawText(painter, false, left, top, width, height, main_flags, main_text);
-            mainh = main_rect.height();
-            mainw = main_rect.width();
-            totalh = caph+endh+mainh;
-
-            // Decrease song text to fit the screen
-            while(mainw > width || totalh > height)
-            {
-                main_font.setPointSize(main_font.pointSize() - 1);
-                painter->setFont(main_font);
-                main_rect = boundRectOrDrawText(painter, false, left, top, width, height, main_flags, main_text);
-                mainh = main_rect.height();
-                mainw = main_rect.width();
-                totalh = caph+endh+mainh;
-            }
+            fitted = fitPointSize(1, textSize,
+                                  estimatePointSize(main_font, main_text, width, height-caph-endh, true), measureMain);
+        }
+        if(measuredSize != fitted || !measuredFits)
+        {
+            ++m_fitLayouts;
+            measureMain(fitted);
         }
         m_sSets.textFont = main_font;
         m_isTextPrepared = true;
@@ -840,37 +1211,24 @@ void ImageGenerator::drawAnnounceText(QPainter *painter, bool isShadow)
 
     if(!m_isTextPrepared)
     {
-        painter->setFont(font);
-        bool exit = false;
-        while( !exit )
+        // Text is always wrapped here, so a single fit is enough
+        int measuredSize = -1;
+        bool measuredFits = false;
+        auto measure = [&](int size) -> bool
         {
+            font.setPointSize(size);
+            painter->setFont(font);
             rect = painter->boundingRect(left, top, w, h, flags, m_announce.text);
-            exit = ( rect.width() <= w && rect.height() <= h );
-            if( !exit )
-            {
-                font.setPointSize( font.pointSize()-1 );
-                painter->setFont(font);
-            }
-        }
-
-        // Force wrapping of songs that have really wide lines:
-        // (Do not allow font to be shrinked less than a 4/5 of the desired font)
-        if( font.pointSize() < (orig_font_size*4/5) )
+            measuredSize = size;
+            measuredFits = ( rect.width() <= w && rect.height() <= h );
+            return measuredFits;
+        };
+        int size = fitPointSize(1, orig_font_size,
+                                estimatePointSize(font, m_announce.text, w, h, true), measure);
+        if(measuredSize != size || !measuredFits)
         {
-            font.setPointSize(orig_font_size);
-            painter->setFont(font);
-            flags = (flags | Qt::TextWordWrap);
-            exit = false;
-            while( !exit )
-            {
-                rect = painter->boundingRect(left, top, w, h, flags, m_announce.text);
-                exit = ( rect.width() <= w && rect.height() <= h );
-                if( !exit )
-                {
-                    font.setPointSize( font.pointSize()-1 );
-                    painter->setFont(font);
-                }
-            }
+            ++m_fitLayouts;
+            measure(size);
         }
         m_aSets.textFont = font;
         m_adSets.tRect = rect;
@@ -888,22 +1246,7 @@ void ImageGenerator::drawAnnounceText(QPainter *painter, bool isShadow)
         painter->setPen(QColor(Qt::black));
     else
         painter->setPen(m_aSets.textColor);
-    painter->drawText(m_adSets.tRect, flags, m_announce.text);
-}
-
-
-QPixmap ImageGenerator::applyEffectToImage(QPixmap src, QGraphicsEffect *effect)
-{
-    if(src.isNull()) return QPixmap(); //No need to do anything else!
-    if(!effect) return src; //No need to do anything else!
-    QGraphicsScene scene;
-    QGraphicsPixmapItem item;
-    item.setPixmap(src);
-    item.setGraphicsEffect(effect);
-    scene.addItem(&item);
-    QPixmap res(src.size());
-    res.fill(Qt::transparent);
-    QPainter ptr(&res);
-    scene.render(&ptr);
-    return res;
+    QRect drawn;
+    painter->drawText(m_adSets.tRect, flags, m_announce.text, &drawn);
+    addTextBounds(painter, drawn);
 }
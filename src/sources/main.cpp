@@ -24,12 +24,14 @@
 #include <QDebug>
 #include "../headers/softprojector.hpp"
 #include "../headers/theme.hpp"
+#include "../headers/sqlstatementcache.hpp"
+#include "../headers/databaseindexes.hpp"
 
 // Definitions for database versions 'dbVer' numbers
 // x - Official release. ex: 2 - for SoftProjector 2
 // xxx - Official sub realeas. ex: 201 - for SoftProjector 2.01
 // 990xxx - Development release. ex: 990206 - for SoftProjector 2 Development Build 6 (2db6)
-int const dbVer = 3;
+int const dbVer = 4;
 
 bool connect(QString database_file)
 {
@@ -66,7 +68,7 @@ bool connect(QString database_file)
                     "'useBackground' BOOL, 'backgoundPath' TEXT, 'font' TEXT, 'color' TEXT, 'alignment' TEXT)");
             sq.exec("CREATE TABLE 'BibleBooks' ('bible_id' INTEGER, 'id' INTEGER, 'book_name' "
                     "TEXT, 'chapter_count' INTEGER DEFAULT 0)");
-            sq.exec("CREATE TABLE 'BibleVerse' ('verse_id' TEXT, 'bible_id' TEXT, 'book' TEXT, "
+            sq.exec("CREATE TABLE 'BibleVerse' ('verse_id' TEXT, 'bible_id' INTEGER, 'book' INTEGER, "
                     "'chapter' INTEGER, 'verse' INTEGER, 'verse_text' TEXT)");
             sq.exec("CREATE TABLE 'BibleVersions' ('id' INTEGER PRIMARY KEY  AUTOINCREMENT  NOT NULL, "
                     "'bible_name' TEXT, 'abbreviation' TEXT, 'information' TEXT, 'right_to_left' INTEGER DEFAULT 0)");
@@ -108,6 +110,7 @@ bool connect(QString database_file)
                     "'background_video_path' TEXT, 'background_video_loop' INTEGER DEFAULT 1, 'background_video_fill_mode' INTEGER DEFAULT 0)");
             //sq.exec("CREATE TABLE 'ThemeData' ('theme_id' INTEGER, 'type' TEXT, 'sets' TEXT)");
             sq.exec("CREATE TABLE 'Themes' ('id' INTEGER PRIMARY KEY  AUTOINCREMENT  NOT NULL , 'name' TEXT, 'comment' TEXT)");
+            createDatabaseIndexes();
         }
         return true;
     }
@@ -118,6 +121,10 @@ int main(int argc, char *argv[])
     QApplication a(argc, argv);
     a.setApplicationName("SoftProjector 3.0");
 
+    // SOFTPROJECTOR_SQL_TIMING=1 prints per-statement timings on exit
+    bool sqlTiming = qEnvironmentVariableIsSet("SOFTPROJECTOR_SQL_TIMING");
+    SqlStatementCache::setTimingEnabled(sqlTiming);
+
     QPixmap pixmap(":icons/icons/splash.png");
     QSplashScreen splash(pixmap);
     splash.setMask(pixmap.mask());
@@ -308,16 +315,29 @@ int main(int argc, char *argv[])
     sq.first();
     int dbVersion = sq.value(0).toInt();
 
-    // Database migration for video backgrounds (version 3)
     if (dbVersion < dbVer) {
         qDebug() << "Performing database migration from version" << dbVersion << "to" << dbVer;
+        int newVersion = dbVer;
 
-        // Migrate theme tables for video backgrounds
-        qDebug() << "Migrating theme tables for video backgrounds...";
-        migrateThemeTablesForVideoBackgrounds();
+        // Database migration for video backgrounds (version 3)
+        if (dbVersion < 3) {
+            qDebug() << "Migrating theme tables for video backgrounds...";
+            migrateThemeTablesForVideoBackgrounds();
+        }
+
+        // Database migration for indexes and integer ids (version 4)
+        if (dbVersion < 4) {
+            qDebug() << "Adding database indexes...";
+            if (!migrateDatabaseForIndexes()) {
+                // Version 3 tables still work with TEXT ids, so keep running
+                // and leave the version at 3 to retry on the next start
+                qWarning() << "Database migration to version 4 failed, keeping version 3";
+                newVersion = 3;
+            }
+        }
 
         // Update database version
-        sq.exec(QString("PRAGMA user_version = %1").arg(dbVer));
+        sq.exec(QString("PRAGMA user_version = %1").arg(newVersion));
         dbVersion = dbVer;
     }
 
@@ -343,5 +363,13 @@ int main(int argc, char *argv[])
     w.setAppDataDir(QDir(database_dir));
     w.show();
     splash.finish(&w);
-    return a.exec();
+    int ret = a.exec();
+
+    // Statement timings, only collected when asked for
+    if (sqlTiming) {
+        foreach (const QString &line, SqlStatementCache::timingReport())
+            qDebug() << qPrintable(line);
+    }
+    SqlStatementCache::clear();
+    return ret;
 }
@@ -104,7 +104,7 @@ void PrintPreviewDialog::setText(QString bible, QString book, int chapter)
 
     Bible b;
     b.setBiblesId(bible);
-    b.loadOperatorBible();
+    b.loadOperatorBible(false); // only need chapter text, no searching
 
     // get bible name instead of id
     bible = b.getBibleName();
@@ -35,7 +35,12 @@ ProjectorDisplayScreen::ProjectorDisplayScreen(QWidget *parent) :
     dispView->setResizeMode(QQuickView::SizeRootObjectToView);
     ui->verticalLayout->addWidget(w);
 
-    backImSwitch1 = backImSwitch2 = textImSwitch1 = textImSwitch2 = false;
+    // Shadows of text are drawn by ImageGenerator until the scene graph is up
+    // and known to be able to draw them. The signals come from the render
+    // thread and are queued to this one.
+    connect(dispView,SIGNAL(sceneGraphInitialized()),this,SLOT(updateShadowDeferral()));
+    connect(dispView,SIGNAL(sceneGraphInvalidated()),this,SLOT(updateShadowDeferral()));
+
     back1to2 = text1to2 = isNewBack = true;
     m_color.setRgb(0,0,0,0);
 
@@ -56,6 +61,15 @@ ProjectorDisplayScreen::~ProjectorDisplayScreen()
     delete ui;
 }
 
+void ProjectorDisplayScreen::updateShadowDeferral()
+{
+    // The API actually in use, Qt falls back to the software renderer when
+    // the requested one can't be initialized. That one has no shader effects.
+    QSGRendererInterface *renderer = dispView->rendererInterface();
+    imGen.setDeferShadow(dispView->isSceneGraphInitialized() && renderer
+                         && renderer->graphicsApi() != QSGRendererInterface::Software);
+}
+
 void ProjectorDisplayScreen::resetImGenSize()
 {
     QSize renderSize = calculateEffectiveRenderSize();
@@ -181,62 +195,38 @@ void ProjectorDisplayScreen::setBackPixmap(QPixmap p, int fillMode)
     back = p;
     isNewBack = true;
 
+    // Scale the image itself, it goes to QML without another conversion
+    QImage image = p.toImage();
     switch(fillMode)
     {
     case 0:
-        p = p.scaled(imGen.getScreenSize(),Qt::IgnoreAspectRatio,Qt::SmoothTransformation);
+        image = image.scaled(imGen.getScreenSize(),Qt::IgnoreAspectRatio,Qt::SmoothTransformation);
         break;
     case 1:
-        p = p.scaled(imGen.getScreenSize(),Qt::KeepAspectRatio,Qt::SmoothTransformation);
+        image = image.scaled(imGen.getScreenSize(),Qt::KeepAspectRatio,Qt::SmoothTransformation);
         break;
     case 2:
-        p = p.scaled(imGen.getScreenSize(),Qt::KeepAspectRatioByExpanding,Qt::SmoothTransformation);
+        image = image.scaled(imGen.getScreenSize(),Qt::KeepAspectRatioByExpanding,Qt::SmoothTransformation);
         break;
     default:
         // Do No Scaling/resizing
         break;
     }
 
-    imProvider->setPixMap(p);
     back1to2 = (!back1to2);
 
-    QObject *item1 = dispView->rootObject()->findChild<QObject*>("backImage1");
-    QObject *item2 = dispView->rootObject()->findChild<QObject*>("backImage2");
-    if(item1 && item2)
+    QObject *item = dispView->rootObject()->findChild<QObject*>(back1to2 ? "backImage2" : "backImage1");
+    if(item)
     {
-        if(back1to2)
-        {
-            backImSwitch2 = (!backImSwitch2);
-            if(backImSwitch2)
-                item2->setProperty("source","image://improvider/imB2a");
-            else
-                item2->setProperty("source","image://improvider/imB2b");
-
-            if(p.height()<imGen.height())
-                item2->setProperty("y",(imGen.height()-p.height())/2);
-            else
-                item2->setProperty("y",0);
-            if(p.width()<imGen.width())
-                item2->setProperty("x",(imGen.width()-p.width())/2);
-            else
-                item2->setProperty("x",0);
-        }
+        item->setProperty("source","image://improvider/" + imProvider->setImage(back1to2 ? "back2" : "back1",image));
+        if(image.height()<imGen.height())
+            item->setProperty("y",(imGen.height()-image.height())/2);
         else
-        {
-            backImSwitch1 = (!backImSwitch1);
-            if(backImSwitch1)
-                item1->setProperty("source","image://improvider/imB1a");
-            else
-                item1->setProperty("source","image://improvider/imB1b");
-            if(p.height()<imGen.height())
-                item1->setProperty("y",(imGen.height()-p.height())/2);
-            else
-                item1->setProperty("y",0);
-            if(p.width()<imGen.width())
-                item1->setProperty("x",(imGen.width()-p.width())/2);
-            else
-                item1->setProperty("x",0);
-        }
+            item->setProperty("y",0);
+        if(image.width()<imGen.width())
+            item->setProperty("x",(imGen.width()-image.width())/2);
+        else
+            item->setProperty("x",0);
     }
 }
 
@@ -250,30 +240,42 @@ void ProjectorDisplayScreen::setBackPixmap(QPixmap p, QColor c)
         setBackPixmap(imGen.generateEmptyImage(),0);
 }
 
-void ProjectorDisplayScreen::setTextPixmap(QPixmap p)
+void ProjectorDisplayScreen::setTextPixmap(QPixmap p, QPoint offset)
+{
+    QImage image = p.toImage();
+    image.setOffset(offset);
+    showTextImage(image,false);
+}
+
+void ProjectorDisplayScreen::setTextImage(const QImage &image)
+{
+    // Generated text, which may have left its shadow to the GPU
+    showTextImage(image,true);
+}
+
+void ProjectorDisplayScreen::showTextImage(const QImage &image, bool generated)
 {
-    imProvider->setPixMap(p);
+    // Text images only cover the text, placed at their offset
     text1to2 = (!text1to2);
 
-    QObject *item1 = dispView->rootObject()->findChild<QObject*>("textImage1");
-    QObject *item2 = dispView->rootObject()->findChild<QObject*>("textImage2");
-    if(item1 && item2)
+    QColor shadowColor;
+    int shadowOffset = 0;
+    qreal blurRadius = 0;
+    bool shadow = generated && imGen.textShadow(&shadowColor,&shadowOffset,&blurRadius);
+
+    QObject *item = dispView->rootObject()->findChild<QObject*>(text1to2 ? "textImage2" : "textImage1");
+    if(item)
     {
-        if(text1to2)
+        item->setProperty("source","image://improvider/" + imProvider->setImage(text1to2 ? "text2" : "text1",image));
+        // The QML transitions move the image from and to this position
+        item->setProperty("baseX",image.offset().x());
+        item->setProperty("baseY",image.offset().y());
+        item->setProperty("shadowEnabled",shadow);
+        if(shadow)
         {
-            textImSwitch2 = (!textImSwitch2);
-            if(textImSwitch2)
-                item2->setProperty("source","image://improvider/imT2a");
-            else
-                item2->setProperty("source","image://improvider/imT2b");
-        }
-        else
-        {
-            textImSwitch1 = (!textImSwitch1);
-            if(textImSwitch1)
-                item1->setProperty("source","image://improvider/imT1a");
-            else
-                item1->setProperty("source","image://improvider/imT1b");
+            item->setProperty("shadowColor",shadowColor);
+            item->setProperty("shadowOffset",shadowOffset);
+            item->setProperty("shadowBlurRadius",blurRadius);
         }
     }
 }
@@ -465,7 +467,7 @@ void ProjectorDisplayScreen::renderBibleText(Verse bVerse, BibleSettings &bSets)
         }
     }
 
-    setTextPixmap(imGen.generateBibleImage(bVerse,bSets));
+    setTextImage(imGen.generateBibleImage(bVerse,bSets));
 
     updateScreen();
 }
@@ -501,7 +503,7 @@ void ProjectorDisplayScreen::renderSongText(Stanza stanza, SongSettings &sSets)
         }
     }
 
-    setTextPixmap(imGen.generateSongImage(stanza,sSets));
+    setTextImage(imGen.generateSongImage(stanza,sSets));
 
     updateScreen();
 }
@@ -537,11 +539,26 @@ void ProjectorDisplayScreen::renderAnnounceText(AnnounceSlide announce, TextSett
         }
     }
 
-    setTextPixmap(imGen.generateAnnounceImage(announce,aSets));
+    setTextImage(imGen.generateAnnounceImage(announce,aSets));
 
     updateScreen();
 }
 
+void ProjectorDisplayScreen::prerenderBibleText(Verse bVerse, BibleSettings &bSets)
+{
+    imGen.prerenderBibleImage(bVerse,bSets);
+}
+
+void ProjectorDisplayScreen::prerenderSongText(Stanza stanza, SongSettings &sSets)
+{
+    imGen.prerenderSongImage(stanza,sSets);
+}
+
+void ProjectorDisplayScreen::prerenderAnnounceText(AnnounceSlide announce, TextSettings &aSets)
+{
+    imGen.prerenderAnnounceImage(announce,aSets);
+}
+
 void ProjectorDisplayScreen::renderSlideShow(QPixmap slide, SlideShowSettings &ssSets)
 {
     tranType = TR_FADE;
@@ -775,6 +775,8 @@ VirtualOutputSettings::VirtualOutputSettings()
     useCustomTheme = false;
      streamThemeId = 0;
     mirrorDisplay1 = true;
+    backgroundCodec = 2;
+    streamFrameRate = 30;
 }
 
 ScreenFormatSettings::ScreenFormatSettings()
@@ -894,6 +896,8 @@ void VirtualOutputSettings::save(QSqlQuery &sq)
         set += "\nmirrorDisplay1 = true";
     else
          set += "\nmirrorDisplay1 = false";
+    set += "\nbackgroundCodec = " + QString::number(backgroundCodec);
+    set += "\nstreamFrameRate = " + QString::number(streamFrameRate);
 
     sq.prepare("INSERT OR REPLACE INTO Settings (type, sets) VALUES ('virtualOutput', ?)");
     sq.addBindValue(set);
@@ -937,6 +941,10 @@ void VirtualOutputSettings::load(QSqlQuery &sq)
                 streamThemeId = v.toInt();
             else if(n == "mirrorDisplay1")
                 mirrorDisplay1 = (v == "true");
+            else if(n == "backgroundCodec")
+                backgroundCodec = v.toInt();
+            else if(n == "streamFrameRate")
+                streamFrameRate = v.toInt();
          }
     }
 }
@@ -971,6 +979,8 @@ void VirtualOutputSettings::update(QSqlQuery &sq)
          set += "\nmirrorDisplay1 = true";
     else
         set += "\nmirrorDisplay1 = false";
+    set += "\nbackgroundCodec = " + QString::number(backgroundCodec);
+    set += "\nstreamFrameRate = " + QString::number(streamFrameRate);
     sq.addBindValue(set);
     sq.exec();
 }
@@ -989,7 +999,9 @@ bool VirtualOutputSettings::operator==(const VirtualOutputSettings &other) const
            overlayPath == other.overlayPath &&
            useCustomTheme == other.useCustomTheme &&
            streamThemeId == other.streamThemeId &&
-           mirrorDisplay1 == other.mirrorDisplay1;
+           mirrorDisplay1 == other.mirrorDisplay1 &&
+           backgroundCodec == other.backgroundCodec &&
+           streamFrameRate == other.streamFrameRate;
 }
 
 void saveScreenFormatSettings(int screenIndex, const ScreenFormatSettings &settings)
@@ -36,6 +36,7 @@ SoftProjector::SoftProjector(QWidget *parent)
     mySettings.loadSettings();
     theme.setThemeId(mySettings.general.currentThemeId);
     theme.loadTheme();
+    streamThemeLoaded = false;
     // Reset current theme id if initial was 0
     mySettings.general.currentThemeId = theme.getThemeId();
 
@@ -443,6 +444,8 @@ void SoftProjector::toggleVirtualOutput()
 
 void SoftProjector::updateVirtualOutputSettings()
 {
+    streamThemeLoaded = false;
+
     if(!virtualOutput && !mySettings.general.virtualOutput.enabled)
         return;
 
@@ -456,6 +459,8 @@ void SoftProjector::updateVirtualOutputSettings()
                             mySettings.general.virtualOutput.streamThemeId);
 
     virtualOutput->setLogoOverlay(mySettings.general.virtualOutput.overlayPath);
+    virtualOutput->setBackgroundCodec(VirtualOutput::AssetCodec(mySettings.general.virtualOutput.backgroundCodec));
+    virtualOutput->setStreamFrameRate(mySettings.general.virtualOutput.streamFrameRate);
 
     if(mySettings.general.virtualOutput.width == 1280 && mySettings.general.virtualOutput.height == 720)
         virtualOutput->setResolution(VirtualOutput::RES_720P);
@@ -475,12 +480,19 @@ Theme SoftProjector::getVirtualOutputTheme()
     if(mySettings.general.virtualOutput.mirrorDisplay1)
         return theme;
 
-    Theme customTheme;
-    customTheme.setThemeId(mySettings.general.virtualOutput.streamThemeId);
-    customTheme.loadTheme();
-    if(customTheme.getThemeId() == 0 && mySettings.general.virtualOutput.streamThemeId != 0)
+    // Loading decodes the backgrounds into new pixmaps, which the virtual
+    // output would encode again. Keep the theme until settings or themes change.
+    if(!streamThemeLoaded)
+    {
+        streamTheme = Theme();
+        streamTheme.setThemeId(mySettings.general.virtualOutput.streamThemeId);
+        streamTheme.loadTheme();
+        streamThemeLoaded = true;
+    }
+    if(streamTheme.getThemeId() == 0 && mySettings.general.virtualOutput.streamThemeId != 0)
         return theme;
 
+    Theme customTheme = streamTheme;
     customTheme.bible.versions = mySettings.bibleSets;
     customTheme.bible2.versions = mySettings.bibleSets2;
     customTheme.bible3.versions = mySettings.bibleSets3;
@@ -1049,22 +1061,22 @@ void SoftProjector::showBible()
         if(ui->listShow->item(i)->isSelected())
             currentRows.append(i);
     }
-    pds1->renderBibleText(bibleWidget->bible.getCurrentVerseAndCaption(
-                              currentRows,theme.bible,mySettings.bibleSets),
-                          theme.bible);
+
+    // Verses are resolved through the Bible verse cache, so screens
+    // sharing settings and translations reuse the same text and caption
+    Bible &bible = bibleWidget->bible;
+    Verse v1 = bible.getCurrentVerseAndCaption(currentRows,theme.bible,mySettings.bibleSets);
+    pds1->renderBibleText(v1,theme.bible);
     if(hasDisplayScreen2)
     {
         if(!theme.bible2.useDisp1settings)
         {
-            pds2->renderBibleText(bibleWidget->bible.
-                                  getCurrentVerseAndCaption(currentRows,theme.bible2,
-                                                            mySettings.bibleSets2),theme.bible2);
+            pds2->renderBibleText(bible.getCurrentVerseAndCaption(currentRows,theme.bible2,
+                                                                  mySettings.bibleSets2),theme.bible2);
         }
         else
         {
-            pds2->renderBibleText(bibleWidget->bible.
-                                  getCurrentVerseAndCaption(currentRows,theme.bible,
-                                                            mySettings.bibleSets),theme.bible);
+            pds2->renderBibleText(v1,theme.bible);
         }
     }
 
@@ -1072,15 +1084,12 @@ void SoftProjector::showBible()
     {
         if(!theme.bible3.useDisp1settings)
         {
-            pds3->renderBibleText(bibleWidget->bible.
-                                  getCurrentVerseAndCaption(currentRows,theme.bible3,
-                                                            mySettings.bibleSets3),theme.bible3);
+            pds3->renderBibleText(bible.getCurrentVerseAndCaption(currentRows,theme.bible3,
+                                                                  mySettings.bibleSets3),theme.bible3);
         }
         else
         {
-            pds3->renderBibleText(bibleWidget->bible.
-                                  getCurrentVerseAndCaption(currentRows,theme.bible,
-                                                            mySettings.bibleSets),theme.bible);
+            pds3->renderBibleText(v1,theme.bible);
         }
     }
 
@@ -1088,26 +1097,68 @@ void SoftProjector::showBible()
     {
         if(!theme.bible4.useDisp1settings)
         {
-            pds4->renderBibleText(bibleWidget->bible.
-                                  getCurrentVerseAndCaption(currentRows,theme.bible4,
-                                                            mySettings.bibleSets4),theme.bible4);
+            pds4->renderBibleText(bible.getCurrentVerseAndCaption(currentRows,theme.bible4,
+                                                                  mySettings.bibleSets4),theme.bible4);
         }
         else
         {
-            pds4->renderBibleText(bibleWidget->bible.
-                                  getCurrentVerseAndCaption(currentRows,theme.bible,
-                                                            mySettings.bibleSets),theme.bible);
+            pds4->renderBibleText(v1,theme.bible);
         }
     }
 
     // Update virtual output if enabled
-    if(virtualOutput && virtualOutput->isEnabled())
+    Theme virtualTheme;
+    bool useVirtual = (virtualOutput && virtualOutput->isEnabled());
+    if(useVirtual)
     {
-        Theme virtualTheme = getVirtualOutputTheme();
-        virtualOutput->renderBibleText(bibleWidget->bible.getCurrentVerseAndCaption(
+        virtualTheme = getVirtualOutputTheme();
+        virtualOutput->renderBibleText(bible.getCurrentVerseAndCaption(
                                            currentRows,virtualTheme.bible,mySettings.bibleSets),
                                        virtualTheme.bible);
     }
+
+    // Resolve the verses that next and previous slide will select and
+    // render them ahead of time, so stepping through verses does not wait
+    if(currentRows.isEmpty())
+        return;
+    QList<QList<int> > neighbours;
+    if(currentRows.last()+1 < srows)
+        neighbours << (QList<int>() << currentRows.last()+1);
+    if(currentRows.first() > 0)
+        neighbours << (QList<int>() << currentRows.first()-1);
+    foreach(const QList<int> &rows, neighbours)
+    {
+        Verse n1 = bible.getCurrentVerseAndCaption(rows,theme.bible,mySettings.bibleSets);
+        pds1->prerenderBibleText(n1,theme.bible);
+        if(hasDisplayScreen2)
+        {
+            if(!theme.bible2.useDisp1settings)
+                pds2->prerenderBibleText(bible.getCurrentVerseAndCaption(rows,theme.bible2,
+                                                                         mySettings.bibleSets2),theme.bible2);
+            else
+                pds2->prerenderBibleText(n1,theme.bible);
+        }
+        if(hasDisplayScreen3)
+        {
+            if(!theme.bible3.useDisp1settings)
+                pds3->prerenderBibleText(bible.getCurrentVerseAndCaption(rows,theme.bible3,
+                                                                         mySettings.bibleSets3),theme.bible3);
+            else
+                pds3->prerenderBibleText(n1,theme.bible);
+        }
+        if(hasDisplayScreen4)
+        {
+            if(!theme.bible4.useDisp1settings)
+                pds4->prerenderBibleText(bible.getCurrentVerseAndCaption(rows,theme.bible4,
+                                                                         mySettings.bibleSets4),theme.bible4);
+            else
+                pds4->prerenderBibleText(n1,theme.bible);
+        }
+        if(useVirtual)
+            virtualOutput->prerenderBibleText(bible.getCurrentVerseAndCaption(
+                                                  rows,virtualTheme.bible,mySettings.bibleSets),
+                                              virtualTheme.bible);
+    }
 }
 
 void SoftProjector::showSong(int currentRow)
@@ -1163,10 +1214,12 @@ void SoftProjector::showSong(int currentRow)
     }
 
     // Update virtual output if enabled
-    if(virtualOutput && virtualOutput->isEnabled())
+    SongSettings virtualSong;
+    bool useVirtual = (virtualOutput && virtualOutput->isEnabled());
+    if(useVirtual)
     {
         Theme virtualTheme = getVirtualOutputTheme();
-        SongSettings virtualSong = virtualTheme.song;
+        virtualSong = virtualTheme.song;
         if(current_song.usePrivateSettings)
         {
             current_song.getSettings(virtualSong);
@@ -1174,6 +1227,25 @@ void SoftProjector::showSong(int currentRow)
         virtualOutput->renderSongText(current_song.getStanza(currentRow),virtualSong);
     }
 
+    // Render next and previous stanza ahead of time
+    QList<int> neighbours;
+    if(currentRow+1 < ui->listShow->count())
+        neighbours << currentRow+1;
+    if(currentRow > 0)
+        neighbours << currentRow-1;
+    foreach(int row, neighbours)
+    {
+        Stanza stanza = current_song.getStanza(row);
+        pds1->prerenderSongText(stanza,s1);
+        if(hasDisplayScreen2)
+            pds2->prerenderSongText(stanza,theme.song2.useDisp1settings ? s1 : s2);
+        if(hasDisplayScreen3)
+            pds3->prerenderSongText(stanza,theme.song3.useDisp1settings ? s1 : s3);
+        if(hasDisplayScreen4)
+            pds4->prerenderSongText(stanza,theme.song4.useDisp1settings ? s1 : s4);
+        if(useVirtual)
+            virtualOutput->prerenderSongText(stanza,virtualSong);
+    }
 }
 
 void SoftProjector::showAnnounce(int currentRow)
@@ -1214,11 +1286,33 @@ void SoftProjector::showAnnounce(int currentRow)
     }
 
     // Update virtual output if enabled
-    if(virtualOutput && virtualOutput->isEnabled())
+    Theme virtualTheme;
+    bool useVirtual = (virtualOutput && virtualOutput->isEnabled());
+    if(useVirtual)
     {
-        Theme virtualTheme = getVirtualOutputTheme();
+        virtualTheme = getVirtualOutputTheme();
         virtualOutput->renderAnnounceText(currentAnnounce.getAnnounceSlide(currentRow),virtualTheme.announce);
     }
+
+    // Render next and previous slide ahead of time
+    QList<int> neighbours;
+    if(currentRow+1 < ui->listShow->count())
+        neighbours << currentRow+1;
+    if(currentRow > 0)
+        neighbours << currentRow-1;
+    foreach(int row, neighbours)
+    {
+        AnnounceSlide slide = currentAnnounce.getAnnounceSlide(row);
+        pds1->prerenderAnnounceText(slide,theme.announce);
+        if(hasDisplayScreen2)
+            pds2->prerenderAnnounceText(slide,theme.announce2.useDisp1settings ? theme.announce : theme.announce2);
+        if(hasDisplayScreen3)
+            pds3->prerenderAnnounceText(slide,theme.announce3.useDisp1settings ? theme.announce : theme.announce3);
+        if(hasDisplayScreen4)
+            pds4->prerenderAnnounceText(slide,theme.announce4.useDisp1settings ? theme.announce : theme.announce4);
+        if(useVirtual)
+            virtualOutput->prerenderAnnounceText(slide,virtualTheme.announce);
+    }
 }
 
 void SoftProjector::showPicture(int currentRow)
@@ -1527,6 +1621,10 @@ void SoftProjector::on_actionManage_Database_triggered()
     manageDialog->load_songbooks();
     manageDialog->setDataDir(appDataDir);
     manageDialog->exec();
+    streamThemeLoaded = false;
+
+    // Bible names or abbreviations may have been edited
+    bibleWidget->bible.clearVerseCache();
 
     // Reload songbooks if Songbook has been added, edited, or deleted
     if (manageDialog->reload_songbook)
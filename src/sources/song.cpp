@@ -20,6 +20,10 @@
 #include "../headers/song.hpp"
 #include <QDebug>
 #include "../headers/spfunctions.hpp"
+#include "../headers/sqlstatementcache.hpp"
+
+// Memory budget of the full song cache in kilobytes
+static const int songCacheBudget = 32 * 1024;
 
 // for future use or chord import
 // to filter out ChorPro chords from within the song text
@@ -205,17 +209,19 @@ void Song::setDefaults()
     backgroundName = "";
     background = QPixmap();
     notes = "";
+    stanzaListValid = false;
 }
 
 void Song::readData()
 {
-    QSqlQuery sq;
     //              0               1       2     3        4    5      6       7         8
     //        9               10        11          12     13    14            15          16         17
     //        18                19              20
-    sq.exec("SELECT songbook_id, number, title, category, tune, words, music, song_text, notes, "
+    QSqlQuery &sq = SqlStatementCache::query("SELECT songbook_id, number, title, category, tune, words, music, song_text, notes, "
             "use_private, alignment_v, alignment_h, color, font, info_color, info_font, ending_color, ending_font, "
-            "use_background, background_name, background FROM Songs WHERE id = " + QString::number(songID));
+            "use_background, background_name, background FROM Songs WHERE id = ?");
+    sq.addBindValue(songID);
+    SqlStatementCache::exec(sq);
     sq.first();
     songbook_id = sq.value(0).toString();
     number = sq.value(1).toInt();
@@ -246,9 +252,73 @@ void Song::readData()
     useBackground = sq.value(18).toBool();
     backgroundName = sq.value(19).toString();
     background.loadFromData(sq.value(20).toByteArray());
+    sq.finish();
+}
+
+void Song::readCatalogData()
+{
+    QSqlQuery &sq = SqlStatementCache::query("SELECT songbook_id, number, title, category, tune FROM Songs WHERE id = ?");
+    sq.addBindValue(songID);
+    SqlStatementCache::exec(sq);
+    sq.first();
+    songbook_id = sq.value(0).toString();
+    number = sq.value(1).toInt();
+    title = sq.value(2).toString();
+    category = sq.value(3).toInt();
+    tune = sq.value(4).toString();
+    sq.finish();
+}
+
+Song Song::catalogEntry() const
+{
+    // Copy of the fields shown in the song table, without text and background
+    Song entry(songID, number, songbook_id, songbook_name);
+    entry.title = title;
+    entry.category = category;
+    entry.tune = tune;
+    return entry;
 }
 
 QStringList Song::getSongTextList()
+{
+    // Every screen asks for the stanzas of the same song, parse the text once
+    if(!stanzaListValid || stanzaListText != songText)
+    {
+        stanzaList = buildSongTextList();
+        stanzaListText = songText;
+        stanzaListValid = true;
+    }
+    return stanzaList;
+}
+
+QSharedPointer<const SongFormat> Song::getFormat()
+{
+    const SongFormat *f = songFormat.data();
+    if(!f || f->usePrivateSettings != usePrivateSettings || f->alignmentV != alignmentV
+            || f->alignmentH != alignmentH || f->color != color || f->font != font
+            || f->infoColor != infoColor || f->infoFont != infoFont || f->endingColor != endingColor
+            || f->endingFont != endingFont || f->useBackground != useBackground
+            || f->backgroundName != backgroundName || f->background.cacheKey() != background.cacheKey())
+    {
+        SongFormat *format = new SongFormat;
+        format->usePrivateSettings = usePrivateSettings;
+        format->alignmentV = alignmentV;
+        format->alignmentH = alignmentH;
+        format->color = color;
+        format->font = font;
+        format->infoColor = infoColor;
+        format->infoFont = infoFont;
+        format->endingColor = endingColor;
+        format->endingFont = endingFont;
+        format->useBackground = useBackground;
+        format->backgroundName = backgroundName;
+        format->background = background;
+        songFormat = QSharedPointer<const SongFormat>(format);
+    }
+    return songFormat;
+}
+
+QStringList Song::buildSongTextList()
 {
     // This function prepares a song list that will be shown in the song preview and show list.
     // It will it will automatically prepare correct sining order of verses and choruses.
@@ -388,18 +458,7 @@ Stanza Song::getStanza(int current)
     stanza.tune = tune;
     stanza.musicBy = musicBy;
     stanza.wordsBy = wordsBy;
-    stanza.usePrivateSettings = usePrivateSettings;
-    stanza.alignmentV = alignmentV;
-    stanza.alignmentH = alignmentH;
-    stanza.useBackground = useBackground;
-    stanza.backgroundName = backgroundName;
-    stanza.background = background;
-    stanza.color = color;
-    stanza.font = font;
-    stanza.infoColor = infoColor;
-    stanza.infoFont = infoFont;
-    stanza.endingColor = endingColor;
-    stanza.endingFont = endingFont;
+    stanza.format = getFormat();
 
     QStringList lines_list = song_list.at(current).split("\n");
     if(isStanzaTitle(lines_list.at(0)))
@@ -425,63 +484,116 @@ SongsModel::SongsModel()
 
 Song SongsModel::getSong(int row)
 {
-    return song_list.at(row);
+    return SongDatabase::loadSong(song_list.at(row));
 }
 
 Song SongsModel::getSong(QModelIndex index)
 {
-    return song_list.at(index.row());
+    return SongDatabase::loadSong(song_list.at(index.row()));
 }
 
 void SongsModel::setSongs(QList<Song> songs)
 {
-    emit layoutAboutToBeChanged();
-    song_list.clear();
+    // The whole list is replaced, so views start over
+    beginResetModel();
     song_list = songs;
-    emit layoutChanged();
+    title_keys.clear();
+    number_keys.clear();
+    title_keys.reserve(song_list.size());
+    number_keys.reserve(song_list.size());
+    for(int i=0; i < song_list.size(); ++i)
+    {
+        title_keys.append(QString());
+        number_keys.append(QString());
+        updateKeys(i);
+    }
+    row_by_id.clear();
+    row_by_id.reserve(song_list.size());
+    updateRows(0);
+    endResetModel();
 }
 
-void SongsModel::updateSongFromDatabase(int songid)
+QString SongsModel::filterKey(const QString &text)
 {
-    emit layoutAboutToBeChanged();
-    for( int i=0; i < song_list.size(); ++i) {
-        Song *song = (Song*)&(song_list.at(i));
-        if( song->songID == songid )
-        {
-            song->readData();
-            emit layoutChanged(); // To redraw the table
-            return;
-        }
+    // Decompose accented letters and drop the marks, so "é" matches "e"
+    QString decomposed = text.normalized(QString::NormalizationForm_D);
+    QString key;
+    key.reserve(decomposed.size());
+    for(QChar c : decomposed)
+    {
+        if(c.category() != QChar::Mark_NonSpacing)
+            key.append(c);
     }
+    return key.toCaseFolded();
+}
+
+void SongsModel::updateKeys(int row)
+{
+    const Song &song = song_list.at(row);
+    title_keys[row] = filterKey(song.title);
+    number_keys[row] = QString::number(song.number);
+}
+
+void SongsModel::updateRows(int from)
+{
+    for(int i=from; i < song_list.size(); ++i)
+        row_by_id.insert(song_list.at(i).songID, i);
+}
+
+int SongsModel::rowForSong(int songid) const
+{
+    return row_by_id.value(songid, -1);
+}
+
+void SongsModel::emitRowChanged(int row)
+{
+    // Only the cells of this row need to be redrawn
+    emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+void SongsModel::updateSongFromDatabase(int songid)
+{
+    int row = rowForSong(songid);
+    if(row < 0)
+        return;
+
+    song_list[row].readCatalogData();
+    updateKeys(row);
+    emitRowChanged(row);
 }
 
 void SongsModel::updateSongFromDatabase(int newSongId, int oldSongId)
 {
-    emit layoutAboutToBeChanged();
-    for( int i=0; i < song_list.size(); i++)
-    {
-        Song *song = (Song*)&(song_list.at(i));
-        if( song->songID == oldSongId )
-        {
-            song->songID = newSongId;
-            // get song number and songbook id
-            song->readData();
-            QSqlQuery sq;
-            // get songbook name
-            sq.exec("SELECT name FROM Songbooks WHERE id = " + song->songbook_id );
-            sq.first();
-            song->songbook_name = sq.value(0).toString();
-
-            emit layoutChanged(); // To redraw the table
-            return;
-        }
-    }
+    int row = rowForSong(oldSongId);
+    if(row < 0)
+        return;
+
+    Song &song = song_list[row];
+    song.songID = newSongId;
+    // get song number and songbook id
+    song.readCatalogData();
+    // get songbook name
+    QSqlQuery &sq = SqlStatementCache::query("SELECT name FROM Songbooks WHERE id = ?");
+    sq.addBindValue(song.songbook_id);
+    SqlStatementCache::exec(sq);
+    sq.first();
+    song.songbook_name = sq.value(0).toString();
+    sq.finish();
+    updateKeys(row);
+
+    row_by_id.remove(oldSongId);
+    row_by_id.insert(newSongId, row);
+    emitRowChanged(row);
 }
 
 void SongsModel::addSong(Song song)
 {
     beginInsertRows(QModelIndex(), rowCount(), rowCount());
     song_list.append(song);
+    title_keys.append(QString());
+    number_keys.append(QString());
+    updateKeys(song_list.size()-1);
+    row_by_id.insert(song.songID, song_list.size()-1);
     endInsertRows();
 }
 
@@ -490,7 +602,14 @@ bool SongsModel::removeRows( int row, int count, const QModelIndex & parent)
     beginRemoveRows(parent, row, row+count-1);
     // Need to remove starting from the end:
     for(int i=row+count-1; i>=row; i--)
+    {
+        row_by_id.remove(song_list.at(i).songID);
         song_list.removeAt(i);
+        title_keys.removeAt(i);
+        number_keys.removeAt(i);
+    }
+    // Rows below the removed ones moved up
+    updateRows(row);
     endRemoveRows();
     return true;
 }
@@ -512,7 +631,8 @@ QVariant SongsModel::data(const QModelIndex &index, int role) const
 
     if( role == Qt::DisplayRole )
     {
-        Song song = song_list.at(index.row());
+        // Called for every painted cell, so no copy of the song
+        const Song &song = song_list.at(index.row());
         if( index.column() == 0 )       //Category
             return QVariant(song.category);
         else if( index.column() == 1 )  //Song Number
@@ -520,7 +640,7 @@ QVariant SongsModel::data(const QModelIndex &index, int role) const
         else if( index.column() == 2)   //Song Title
             return QVariant(song.title);
         else if( index.column() == 3)   //Songbook
-            return QVariant(song.getSongbookName());
+            return QVariant(song.songbook_name);
         else if( index.column() == 4)   //Tune
             return QVariant(song.tune);
     }
@@ -545,43 +665,50 @@ QVariant SongsModel::headerData(int section, Qt::Orientation orientation,int rol
     return QVariant();
 }
 
-void SongsModel::emitLayoutChanged()
-{
-    emit layoutChanged();
-}
-
-void SongsModel::emitLayoutAboutToBeChanged()
-{
-    emit layoutAboutToBeChanged();
-}
-
-bool SongsModel::isInTable(int songid)
+bool SongsModel::isInTable(int songid) const
 {
-    foreach(Song agent, song_list)
-        if(agent.songID == songid)
-            return true;
-    return false;
+    return row_by_id.contains(songid);
 }
 
 SongProxyModel::SongProxyModel(QObject *parent) : QSortFilterProxyModel(parent)
 {
+    category_filter = -1;
+    match_beginning = exact_match = false;
 }
 
 void SongProxyModel::setFilterString(QString new_string, bool new_match_beginning, bool new_exact_match)
 {
+    if(new_string == filter_string && new_match_beginning == match_beginning
+            && new_exact_match == exact_match)
+        return;
+
     filter_string = new_string;
     match_beginning = new_match_beginning;
     exact_match = new_exact_match;
+
+    // Rows are matched on their folded keys, so fold the filter the same way
+    filter_key = SongsModel::filterKey(filter_string);
+    QString s = filter_key;
+    s.replace(" ","\\W*");
+    filter_rx.setPattern(match_beginning ? "^"+s : s);
+    filter_rx.optimize();
+    invalidateFilter();
 }
 
 void SongProxyModel::setSongbookFilter(QString new_songbook)
 {
+    if(new_songbook == songbook_filter)
+        return;
     songbook_filter = new_songbook;
+    invalidateFilter();
 }
 
 void SongProxyModel::setCategoryFilter(int category)
 {
-    category_filter = QString::number(category);
+    if(category == category_filter)
+        return;
+    category_filter = category;
+    invalidateFilter();
 }
 
 /**
@@ -593,28 +720,18 @@ void SongProxyModel::setCategoryFilter(int category)
 bool SongProxyModel::filterAcceptsRow(int sourceRow,
                                       const QModelIndex &sourceParent) const
 {
-    bool retValue = false;
-    QRegularExpression rx;
-    QString s;
-
-    QModelIndex index0 = sourceModel()->index(sourceRow, 0, sourceParent);//Category
-    QModelIndex index1 = sourceModel()->index(sourceRow, 1, sourceParent);//Song Number
-    QModelIndex index2 = sourceModel()->index(sourceRow, 2, sourceParent);//Song Title
-    QModelIndex index3 = sourceModel()->index(sourceRow, 3, sourceParent);//Songbook
-
-    QString str0 = sourceModel()->data(index0).toString();//Category
-    QString str1 = sourceModel()->data(index1).toString();//Song Number
-    QString str2 = sourceModel()->data(index2).toString();//Song Title
-    QString str3 = sourceModel()->data(index3).toString();//Songbook
+    // Runs for every row on every keystroke, read the catalog directly
+    const SongsModel *songs = static_cast<const SongsModel*>(sourceModel());
+    const Song &song = songs->song_list.at(sourceRow);
 
     // Exclude rows that are not part of the selected songbook:
     if( songbook_filter != "ALL" )
-        if( str3 != songbook_filter )
+        if( song.songbook_name != songbook_filter )
             return false;
 
     // Exclude rows that are not part of selected category
-    if(category_filter != "-1")
-        if( str0 != category_filter)
+    if(category_filter != -1)
+        if( song.category != category_filter)
             return false;
 
     if( filter_string.isEmpty() )
@@ -622,25 +739,11 @@ bool SongProxyModel::filterAcceptsRow(int sourceRow,
         return true;
 
     // Process filtering
-    rx.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
-    s = filter_string;
-    s.replace(" ","\\W*");
-
+    const QString &number_key = songs->numberKey(sourceRow);
+    const QString &title_key = songs->titleKey(sourceRow);
     if(exact_match)
-        retValue = ( str1.compare(filter_string, Qt::CaseInsensitive) == 0
-                 || str2.compare(filter_string, Qt::CaseInsensitive) == 0 );
-    else if(match_beginning)
-    {
-        rx.setPattern("^"+s);
-        retValue = (str1.contains(rx) || str2.contains(rx) );
-    }
-    else
-    {
-        rx.setPattern(s);
-        retValue = (str1.contains(rx) || str2.contains(rx) );
-    }
-
-    return retValue;
+        return ( number_key == filter_key || title_key == filter_key );
+    return ( filter_rx.match(number_key).hasMatch() || filter_rx.match(title_key).hasMatch() );
 }
 
 SongDatabase::SongDatabase()
@@ -678,6 +781,7 @@ void Song::saveUpdate()
     sq.addBindValue(pixToByte(background));
     sq.addBindValue(songID);
     sq.exec();
+    SongDatabase::forgetSong(songID);
 }
 
 void Song::saveNew()
@@ -714,9 +818,7 @@ void Song::saveNew()
 
 Song SongDatabase::getSong(int id)
 {
-    Song song(id);
-    song.readData();
-    return song;
+    return loadSong(Song(id));
 }
 
 QList<Song> SongDatabase::getSongs()
@@ -724,64 +826,59 @@ QList<Song> SongDatabase::getSongs()
     QList<Song> songs;
 
     QSqlQuery sq;
-    QStringList sb_ids, sb_names;
+    QHash<QString,QString> sb_names;
 
     // get songbook names and ids
     sq.exec("SELECT id, name FROM Songbooks");
     while (sq.next())
-    {
-        sb_ids << sq.value(0).toString();
-        sb_names << sq.value(1).toString();
-    }
+        sb_names.insert(sq.value(0).toString(), sq.value(1).toString());
     sq.clear();
 
-    // get songs
-    //              0               1       2     3        4    5      6       7         8
-    //        9               10        11          12     13    14            15          16         17
-    //        18                19              20
-    sq.exec("SELECT id, songbook_id, number, title, category, tune, words, music, song_text, notes, "
-            "use_private, alignment_v, alignment_h, color, font, info_color, info_font, ending_color, ending_font, "
-            "use_background, background_name, background FROM Songs");
+    // get the song catalog, text and backgrounds are read when a song is used
+    sq.setForwardOnly(true);
+    sq.exec("SELECT id, songbook_id, number, title, category, tune FROM Songs");
     while(sq.next())
     {
-        Song song;
-        song.songID = sq.value(0).toInt();
-        song.songbook_id = sq.value(1).toString();
-        song.number = sq.value(2).toInt();
+        Song song(sq.value(0).toInt(), sq.value(2).toInt(), sq.value(1).toString(), QString());
         song.title = sq.value(3).toString();
         song.category = sq.value(4).toInt();
         song.tune = sq.value(5).toString();
-        song.wordsBy = sq.value(6).toString();
-        song.musicBy = sq.value(7).toString();
-        song.songText = sq.value(8).toString();
-        song.notes = sq.value(9).toString();
-        song.usePrivateSettings = sq.value(10).toBool();
-        if(!sq.value(11).isNull())
-            song.alignmentV = sq.value(11).toInt();
-        if(!sq.value(12).isNull())
-            song.alignmentH = sq.value(12).toInt();
-        if(!sq.value(13).isNull())
-            song.color = QColor::fromRgb(sq.value(13).toUInt());
-        if(!sq.value(14).isNull())
-            song.font.fromString(sq.value(14).toString());
-        if(!sq.value(15).isNull())
-            song.infoColor = QColor::fromRgb(sq.value(15).toUInt());
-        if(!sq.value(16).isNull())
-            song.infoFont.fromString(sq.value(16).toString());
-        if(!sq.value(17).isNull())
-            song.endingColor = QColor::fromRgb(sq.value(17).toUInt());
-        if(!sq.value(18).isNull())
-            song.endingFont.fromString(sq.value(18).toString());
-        song.useBackground = sq.value(19).toBool();
-        song.backgroundName = sq.value(20).toString();
-        song.background.loadFromData(sq.value(21).toByteArray());
-        song.songbook_name = sb_names.at(sb_ids.indexOf(song.songbook_id));
+        song.songbook_name = sb_names.value(song.songbook_id);
 
         songs.append(song);
     }
     return songs;
 }
 
+QCache<int,Song> &SongDatabase::songCache()
+{
+    static QCache<int,Song> cache(songCacheBudget);
+    return cache;
+}
+
+Song SongDatabase::loadSong(const Song &entry)
+{
+    // Unsaved songs and songs that are already complete are used as they are
+    if(entry.songID <= 0 || !entry.songText.isEmpty())
+        return entry;
+
+    Song *cached = songCache().object(entry.songID);
+    if(cached)
+        return *cached;
+
+    Song song = entry;
+    song.readData();
+    int cost = 1 + (song.songText.size() * 2 + song.notes.size() * 2
+                    + song.background.width() * song.background.height() * 4) / 1024;
+    songCache().insert(song.songID, new Song(song), cost);
+    return song;
+}
+
+void SongDatabase::forgetSong(int songId)
+{
+    songCache().remove(songId);
+}
+
 bool Song::isValid()
 {
     // Check if song is valid by song id
@@ -826,6 +923,7 @@ void SongDatabase::deleteSong(int song_id)
 {
     QSqlQuery sq;
     sq.exec("DELETE FROM Songs WHERE id = " + QString::number(song_id) );
+    forgetSong(song_id);
 }
 
 QString SongDatabase::getSongbookIdStringFromName(QString songbook_name)
@@ -19,6 +19,7 @@
 
 #include "../headers/songcounter.hpp"
 #include "ui_songcounter.h"
+#include "../headers/sqlstatementcache.hpp"
 
 SongCounter::SongCounter(QWidget *parent, QString loc) :
     QDialog(parent),
@@ -94,11 +95,12 @@ void SongCounter::addSongCount(Song song)
     int current_count(0);
 
     // get current song count
-    QSqlQuery sq;
-    sq.exec("SELECT count FROM Songs WHERE id = '" + QString::number(id) + "' ");
+    QSqlQuery &sq = SqlStatementCache::query("SELECT count FROM Songs WHERE id = ?");
+    sq.addBindValue(id);
+    SqlStatementCache::exec(sq);
     sq.first();
     current_count = sq.value(0).toInt();
-    sq.clear();
+    sq.finish();
 
     // add one count to song
     ++current_count;
@@ -106,7 +108,11 @@ void SongCounter::addSongCount(Song song)
     // set todays date
     QDate d(QDate::currentDate());
 
-    sq.exec(QString("UPDATE Songs SET count = %1 , date = '%2' WHERE id = %3").arg(QString::number(current_count)).arg(d.toString("MM:dd:yyyy")).arg(QString::number(id)));
+    QSqlQuery &usq = SqlStatementCache::query("UPDATE Songs SET count = ? , date = ? WHERE id = ?");
+    usq.addBindValue(current_count);
+    usq.addBindValue(d.toString("MM:dd:yyyy"));
+    usq.addBindValue(id);
+    SqlStatementCache::exec(usq);
     //    sq.exec("UPDATE Songs SET count = " + QString::number(current_count) + " WHERE id = " + QString::number(id));
 }
 
@@ -117,27 +123,25 @@ QList<Counter> SongCounter::getSongCounts()
 {
     QList<Counter> song_counts;
     Counter song_count;
-    QSqlQuery sq, sq1;
 
-    // Get counts
+    // Get counts together with songbook names
     //              0   1               2       3   4       5
-    sq.exec("SELECT id, songbook_id, number, title, count, date FROM Songs WHERE count > 0");
+    QSqlQuery &sq = SqlStatementCache::query("SELECT Songs.id, Songbooks.name, Songs.number, Songs.title, Songs.count, Songs.date "
+                                             "FROM Songs LEFT JOIN Songbooks ON Songbooks.id = Songs.songbook_id "
+                                             "WHERE Songs.count > 0");
+    SqlStatementCache::exec(sq);
     while (sq.next())
     {
         song_count.id = sq.value(0).toString();
-        QString sbid = sq.value(1).toString();
+        song_count.songbook = sq.value(1).toString();
         song_count.number = sq.value(2).toInt();
         song_count.title = sq.value(3).toString();
         song_count.count = sq.value(4).toInt();
         song_count.date = sq.value(5).toString();
         updateMonth(song_count.date);
-
-        // get songbook name
-        sq1.exec("SELECT name FROM Songbooks WHERE id = " + sbid);
-        sq1.first();
-        song_count.songbook = sq1.value(0).toString();
         song_counts.append(song_count);
     }
+    sq.finish();
     return song_counts;
 }
 
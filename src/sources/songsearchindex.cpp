@@ -0,0 +1,221 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include "../headers/songsearchindex.hpp"
+#include "../headers/sqlstatementcache.hpp"
+
+namespace {
+
+// Songs returned when matching on trigrams only
+const int fuzzyResultLimit = 50;
+
+// Shortest text the trigram index can look up
+const int trigramLength = 3;
+
+struct IndexState
+{
+    bool checked = false;
+    bool available = false;
+    bool fuzzy = false;
+};
+
+IndexState &state()
+{
+    static IndexState s;
+    return s;
+}
+
+QString quoted(const QString &token)
+{
+    return QLatin1Char('"') + QString(token).replace(QLatin1Char('"'), QLatin1String("\"\"")) + QLatin1Char('"');
+}
+
+void dropTriggers(const QString &table)
+{
+    QSqlQuery sq;
+    sq.exec(QString("DROP TRIGGER IF EXISTS %1Insert").arg(table));
+    sq.exec(QString("DROP TRIGGER IF EXISTS %1Delete").arg(table));
+    sq.exec(QString("DROP TRIGGER IF EXISTS %1Update").arg(table));
+}
+
+// Makes sure <table> is an FTS5 index over the title and lyrics in Songs.
+// The index holds no copy of the text, so every change of Songs has to be
+// passed on with the text it replaces, which the triggers do.
+bool createIndexTable(const QString &table, const QString &tokenizer)
+{
+    QSqlQuery sq;
+    sq.prepare("SELECT sql FROM sqlite_master WHERE type = 'table' AND name = ?");
+    sq.addBindValue(table);
+    sq.exec();
+    bool exists = sq.first();
+    bool current = exists && sq.value(0).toString().contains(QLatin1String("content='Songs'"));
+    sq.finish();
+    if(current)
+        // Fails where the SQLite build has no FTS5
+        return sq.exec(QString("SELECT rowid FROM %1 WHERE 0").arg(table));
+
+    QSqlDatabase::database().transaction();
+    // Earlier versions kept their own copy of every lyric
+    if(exists)
+        sq.exec(QString("DROP TABLE %1").arg(table));
+    dropTriggers(table);
+
+    bool created = sq.exec(QString("CREATE VIRTUAL TABLE %1 USING fts5(title, song_text, "
+                                   "content='Songs', content_rowid='id', tokenize = '%2')").arg(table, tokenizer));
+    if(created)
+    {
+        sq.exec(QString("CREATE TRIGGER %1Insert AFTER INSERT ON Songs BEGIN "
+                        "INSERT INTO %1 (rowid, title, song_text) VALUES (new.id, new.title, new.song_text); END").arg(table));
+        sq.exec(QString("CREATE TRIGGER %1Delete AFTER DELETE ON Songs BEGIN "
+                        "INSERT INTO %1 (%1, rowid, title, song_text) VALUES ('delete', old.id, old.title, old.song_text); END").arg(table));
+        sq.exec(QString("CREATE TRIGGER %1Update AFTER UPDATE OF title, song_text ON Songs BEGIN "
+                        "INSERT INTO %1 (%1, rowid, title, song_text) VALUES ('delete', old.id, old.title, old.song_text); "
+                        "INSERT INTO %1 (rowid, title, song_text) VALUES (new.id, new.title, new.song_text); END").arg(table));
+        sq.exec(QString("INSERT INTO %1 (%1) VALUES ('rebuild')").arg(table));
+    }
+    QSqlDatabase::database().commit();
+    return created;
+}
+
+}
+
+bool SongSearchIndex::isAvailable()
+{
+    IndexState &s = state();
+    if(!s.checked)
+    {
+        s.checked = true;
+        s.available = createIndexTable("SongSearch", "unicode61 remove_diacritics 2");
+        // The trigram tokenizer needs SQLite 3.34
+        s.fuzzy = s.available && createIndexTable("SongTrigrams", "trigram");
+        // Triggers left by a build with FTS5 or trigrams would make every
+        // write to Songs fail
+        if(!s.available)
+        {
+            dropTriggers("SongSearch");
+            qWarning() << "SQLite FTS5 not available, song search scans all lyrics";
+        }
+        if(!s.fuzzy)
+            dropTriggers("SongTrigrams");
+    }
+    return s.available;
+}
+
+void SongSearchIndex::synchronize()
+{
+    // Imports and songbook deletes write Songs directly, the triggers cover
+    // them. Only new tables need building, which isAvailable() does.
+    isAvailable();
+}
+
+bool SongSearchIndex::search(const QString &text, int type, const QRegularExpression &verify, QList<int> *songIds)
+{
+    if(!isAvailable())
+        return false;
+
+    songIds->clear();
+
+    QStringList tokens = text.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    if(tokens.isEmpty())
+        return true;
+
+    bool check = verify.isValid() && !verify.pattern().isEmpty();
+    if(check)
+    {
+        // Phrase and line patterns match partial words and words run together
+        // ("sun shine" finds "sunshine"), whole word tokens can't answer them.
+        // Every word of the search is somewhere in a matching song though, so
+        // songs holding all words long enough for trigrams are the candidates.
+        // Each is checked against the pattern the scan would use.
+        if(!state().fuzzy)
+            return false;
+        QStringList terms;
+        foreach(const QString &token, tokens)
+        {
+            if(token.size() >= trigramLength)
+                terms << quoted(token);
+        }
+        if(terms.isEmpty())
+            return false;
+
+        QSqlQuery &sq = SqlStatementCache::query("SELECT Songs.id, Songs.song_text FROM SongTrigrams "
+                                                 "JOIN Songs ON Songs.id = SongTrigrams.rowid "
+                                                 "WHERE SongTrigrams MATCH ? ORDER BY SongTrigrams.rank");
+        sq.addBindValue(terms.join(QLatin1String(" AND ")));
+        SqlStatementCache::exec(sq);
+        while(sq.next())
+        {
+            if(sq.value(1).toString().contains(verify))
+                songIds->append(sq.value(0).toInt());
+        }
+        sq.finish();
+    }
+    else
+    {
+        QStringList terms;
+        foreach(const QString &token, tokens)
+            terms << quoted(token);
+
+        // Whole words, with case and diacritics folded
+        QString match;
+        if(type == CONTAINS_ANY_WORD)
+            match = terms.join(QLatin1String(" OR "));
+        else if(type == CONTAINS_ALL_WORDS)
+            match = terms.join(QLatin1String(" AND "));
+        else
+            match = quoted(tokens.join(QLatin1Char(' ')));
+
+        QSqlQuery &sq = SqlStatementCache::query("SELECT rowid FROM SongSearch WHERE SongSearch MATCH ? "
+                                                 "ORDER BY bm25(SongSearch, 2.0, 1.0)");
+        sq.addBindValue(match);
+        SqlStatementCache::exec(sq);
+        while(sq.next())
+            songIds->append(sq.value(0).toInt());
+        sq.finish();
+    }
+
+    // Nothing matched, rank songs by the trigrams they share with the search
+    // text so that misremembered words still find the song
+    if(songIds->isEmpty() && state().fuzzy)
+    {
+        QStringList trigrams;
+        foreach(const QString &token, tokens)
+        {
+            for(int i = 0; i + trigramLength <= token.size(); ++i)
+            {
+                QString trigram = quoted(token.mid(i, trigramLength));
+                if(!trigrams.contains(trigram))
+                    trigrams << trigram;
+            }
+        }
+        if(!trigrams.isEmpty())
+        {
+            QSqlQuery &tq = SqlStatementCache::query("SELECT rowid FROM SongTrigrams WHERE SongTrigrams MATCH ? "
+                                                     "ORDER BY rank LIMIT ?");
+            tq.addBindValue(trigrams.join(QLatin1String(" OR ")));
+            tq.addBindValue(fuzzyResultLimit);
+            SqlStatementCache::exec(tq);
+            while(tq.next())
+                songIds->append(tq.value(0).toInt());
+            tq.finish();
+        }
+    }
+
+    return true;
+}
@@ -19,6 +19,7 @@
 
 #include <QDebug>
 #include "../headers/songwidget.hpp"
+#include "../headers/songsearchindex.hpp"
 #include "ui_songwidget.h"
 
 SongWidget::SongWidget(QWidget *parent) :
@@ -116,6 +117,7 @@ void SongWidget::loadSongbooks()
     ui->songbook_menu->addItems(sbor);
     allSongs = song_database.getSongs();
     songs_model->setSongs(allSongs);
+    SongSearchIndex::synchronize();
 
     // Hide song search items
     ui->comboBoxSearchType->setVisible(false);
@@ -158,10 +160,14 @@ void SongWidget::selectMatchingSong(QString text)
 
         if( matches )
         {
+            // The view shows proxy rows, so map the row <i> first
+            QModelIndex proxy_index = proxy_model->mapFromSource(songs_model->index(i, 0));
+            if( !proxy_index.isValid() )
+                continue;
             // Select the row <i>:
-            ui->songs_view->selectRow(i);
+            ui->songs_view->selectRow(proxy_index.row());
             // Scroll the songs table to the row <i>:
-            ui->songs_view->scrollTo( songs_model->index(i, 0) );
+            ui->songs_view->scrollTo(proxy_index);
             return;
         }
     }
@@ -227,9 +233,7 @@ void SongWidget::on_songbook_menu_currentIndexChanged(int index)
         ui->song_num_spinbox->setEnabled(false);
     }
 
-    songs_model->emitLayoutAboutToBeChanged(); //prepeare to chage layout
     proxy_model->setSongbookFilter(songbookName);
-    songs_model->emitLayoutChanged(); // forces the view to redraw
 
     updateButtonStates();
 
@@ -274,7 +278,7 @@ void SongWidget::on_song_num_spinbox_valueChanged(int value)
             {
                 // This song is filtered out using text filter, so can't select
                 // it in the table. Just show it:
-                sendToPreview(s);
+                sendToPreview(SongDatabase::loadSong(s));
                 isSongFromSchelude = false;
             }
             return;
@@ -324,9 +328,7 @@ void SongWidget::on_lineEditSearch_textEdited(QString text)
         bool match_beginning = (ui->comboBoxFilterType->currentIndex() == 1);
         bool exact_match = (ui->comboBoxFilterType->currentIndex() == 2);
 
-        songs_model->emitLayoutAboutToBeChanged(); // prepares view to be redrawn
         proxy_model->setFilterString(text, match_beginning, exact_match);
-        songs_model->emitLayoutChanged(); // forces the view to redraw
 
         // Select the first row that matches the new filter:
         ui->songs_view->selectRow(0);
@@ -397,6 +399,8 @@ void SongWidget::updateSongbooks()
 
 void SongWidget::updateSongFromDatabase(int songid, int initial_sid)
 {
+    SongDatabase::forgetSong(songid);
+    SongDatabase::forgetSong(initial_sid);
     songs_model->updateSongFromDatabase(songid, initial_sid);
 
     // Update in allSongs list
@@ -407,7 +411,7 @@ void SongWidget::updateSongFromDatabase(int songid, int initial_sid)
         {
             Song s;
             s = allSongs.at(i);
-            s.readData();
+            s.readCatalogData();
             allSongs.removeAt(i);
             allSongs.append(s);
             break;
@@ -432,22 +436,16 @@ void SongWidget::deleteSong()
 void SongWidget::addNewSong(Song song, int initial_sid)
 {
 
-    songs_model->addSong(song);
-    allSongs.append(song);
+    songs_model->addSong(song.catalogEntry());
+    allSongs.append(song.catalogEntry());
 
-    // Get added song row number to select it.
-    // If added song is not found list, no selection will be done
-    int row = 0;
-    for(int i(0);i<proxy_model->rowCount();++i)
+    // Select the added song. If it is filtered out, no selection will be done
+    QModelIndex proxy_index = proxy_model->mapFromSource(
+                songs_model->index(songs_model->rowForSong(song.songID), 0));
+    if(proxy_index.isValid())
     {
-        row = i;
-        if(song.title == songs_model->getSong(
-                    proxy_model->mapToSource(
-                        ui->songs_view->indexAt(QPoint(0,i*20)))).title)
-        {
-            ui->songs_view->selectRow(row);
-            break;
-        }
+        ui->songs_view->selectRow(proxy_index.row());
+        ui->songs_view->scrollTo(proxy_index);
     }
 
     sendToPreview(song);
@@ -538,12 +536,10 @@ void SongWidget::on_comboBoxCategory_currentIndexChanged(int index)
 {
     if(index!=-1)
     {
-        songs_model->emitLayoutAboutToBeChanged(); //prepeare to chage layout
         if(index==0)
             proxy_model->setCategoryFilter(index-1);
         else
             proxy_model->setCategoryFilter(cat_ids.at(index-1));
-        songs_model->emitLayoutChanged();
     }
 }
 
@@ -551,6 +547,7 @@ void SongWidget::on_pushButtonSearch_clicked()
 {
     QString search_text = ui->lineEditSearch->text();
     search_text = clean(search_text); // remove all none alphanumeric charecters
+    QString index_text = search_text;
     QList<Song> search_results;
     int type = ui->comboBoxSearchType->currentIndex();
 
@@ -582,16 +579,47 @@ void SongWidget::on_pushButtonSearch_clicked()
         // Search text phrase
         rx.setPattern(search_text);
 
-    // perform search
+    // perform search, song text is not kept in the catalog so read it row by row
+    QHash<int,int> catalog_rows;
     for(int i(0);i<allSongs.count();++i)
+        catalog_rows.insert(allSongs.at(i).songID, i);
+
+    // The search index returns ranked ids, words are matched whole there so
+    // only the phrase and line searches need the pattern checked
+    QList<int> found_ids;
+    bool indexed = SongSearchIndex::search(index_text, type, type < 3 ? rx : QRegularExpression(), &found_ids);
+    if(indexed)
     {
+        foreach(int id, found_ids)
+        {
+            int i = catalog_rows.value(id, -1);
+            if(i >= 0)
+                search_results.append(allSongs.at(i));
+        }
+    }
+
+    // When the index can't answer, scan every song. Word patterns are compiled once.
+    QList<QRegularExpression> word_rx;
+    if(type == 4)
+        foreach(const QString &word, search_text.split("|"))
+            word_rx.append(QRegularExpression("\\b"+word+"\\b",QRegularExpression::CaseInsensitiveOption));
+
+    QSqlQuery sq;
+    sq.setForwardOnly(true);
+    if(!indexed)
+        sq.exec("SELECT id, song_text FROM Songs");
+    while(sq.isActive() && sq.next())
+    {
+        int i = catalog_rows.value(sq.value(0).toInt(), -1);
+        if(i < 0)
+            continue;
+        QString song_text = sq.value(1).toString();
         if(type == 4)
         {
-            QStringList stl = search_text.split("|");
             bool hasAll = false;
-            for(int j(0);j<stl.count();++j)
+            for(int j(0);j<word_rx.count();++j)
             {
-                hasAll = allSongs.at(i).songText.contains(QRegularExpression("\\b"+stl.at(j)+"\\b",QRegularExpression::CaseInsensitiveOption));
+                hasAll = song_text.contains(word_rx.at(j));
                 if(!hasAll)
                     break;
             }
@@ -600,7 +628,7 @@ void SongWidget::on_pushButtonSearch_clicked()
         }
         else
         {
-            if(allSongs.at(i).songText.contains(rx))
+            if(song_text.contains(rx))
                 search_results.append(allSongs.at(i));
         }
     }
@@ -623,9 +651,8 @@ void SongWidget::on_pushButtonSearch_clicked()
     else
         highlight->highlighter->setHighlightText(rx.pattern());
     // reset filter on song table to show all results
-    songs_model->emitLayoutAboutToBeChanged(); // prepares view to be redrawn
     proxy_model->setFilterString("", false, false);
-    songs_model->emitLayoutChanged(); // forces the view to redraw
+    proxy_model->sort(-1); // keep the ranking of the search
 
     ui->songs_view->selectRow(0);
     ui->songs_view->scrollToTop();
@@ -660,6 +687,7 @@ void SongWidget::on_pushButtonClearResults_clicked()
     ui->labelSearchType->setText(tr("Filter Type:"));
     ui->labelFilter->setText(tr("Filter:"));
     songs_model->setSongs(allSongs);
+    proxy_model->sort(1);
     ui->lineEditSearch->clear();
     Song s;
     sendToPreview(s);
@@ -19,17 +19,48 @@
 
 #include "../headers/spimageprovider.hpp"
 
+#include <QMutexLocker>
+
 SpImageProvider::SpImageProvider() :
-    QQuickImageProvider(QQuickImageProvider::Pixmap)
+    QQuickImageProvider(QQuickImageProvider::Image),
+    m_version(0)
+{
+}
+
+QImage SpImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
 {
+    // Requests may come from the QML image loader thread
+    QImage image;
+    {
+        QMutexLocker locker(&m_mutex);
+        image = m_images.value(id.section(QLatin1Char('/'), 0, 0));
+    }
+
+    if(!image.isNull())
+    {
+        if(requestedSize.width() > 0 && requestedSize.height() > 0)
+            image = image.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        else if(requestedSize.width() > 0)
+            image = image.scaledToWidth(requestedSize.width(), Qt::SmoothTransformation);
+        else if(requestedSize.height() > 0)
+            image = image.scaledToHeight(requestedSize.height(), Qt::SmoothTransformation);
+    }
+
+    if(size)
+        *size = image.size();
+    return image;
 }
 
-QPixmap SpImageProvider::requestPixmap(const QString &id, QSize *size, const QSize &requestedSize)
+QString SpImageProvider::setImage(const QString &slot, const QImage &image)
 {
-    return m_pixmap;
+    // Images are implicitly shared, the slot only holds a reference
+    QMutexLocker locker(&m_mutex);
+    m_images.insert(slot, image);
+    return QString("%1/%2").arg(slot).arg(++m_version);
 }
 
-void SpImageProvider::setPixMap(QPixmap &p)
+void SpImageProvider::clearImage(const QString &slot)
 {
-    m_pixmap = p;
+    QMutexLocker locker(&m_mutex);
+    m_images.remove(slot);
 }
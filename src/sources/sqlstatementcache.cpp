@@ -0,0 +1,117 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include "../headers/sqlstatementcache.hpp"
+
+namespace {
+
+struct QueryTiming
+{
+    quint64 calls = 0;
+    qint64 totalNs = 0;
+    qint64 maxNs = 0;
+};
+
+struct StatementStore
+{
+    QHash<QString,QSqlQuery*> statements; // "connection\nsql" -> prepared query
+    QHash<QString,QueryTiming> timings; // sql -> timing
+    bool timingEnabled = false;
+    ~StatementStore() { qDeleteAll(statements); }
+};
+
+StatementStore &store()
+{
+    static StatementStore s;
+    return s;
+}
+
+}
+
+QSqlQuery &SqlStatementCache::query(const QString &sql, const QString &connection)
+{
+    StatementStore &s = store();
+    QString key = connection + QLatin1Char('\n') + sql;
+    QSqlQuery *q = s.statements.value(key);
+    if(!q)
+    {
+        q = new QSqlQuery(QSqlDatabase::database(connection));
+        q->setForwardOnly(true);
+        if(!q->prepare(sql))
+            qWarning() << "Failed to prepare statement:" << sql << q->lastError().text();
+        s.statements.insert(key, q);
+    }
+    else
+        q->finish(); // release results of the previous use
+
+    return *q;
+}
+
+bool SqlStatementCache::exec(QSqlQuery &query)
+{
+    StatementStore &s = store();
+    bool ok;
+    if(s.timingEnabled)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        ok = query.exec();
+        qint64 ns = timer.nsecsElapsed();
+
+        QueryTiming &t = s.timings[query.lastQuery()];
+        ++t.calls;
+        t.totalNs += ns;
+        t.maxNs = qMax(t.maxNs, ns);
+    }
+    else
+        ok = query.exec();
+
+    if(!ok)
+        qWarning() << "Query failed:" << query.lastQuery() << query.lastError().text();
+    return ok;
+}
+
+void SqlStatementCache::setTimingEnabled(bool enabled)
+{
+    store().timingEnabled = enabled;
+}
+
+QStringList SqlStatementCache::timingReport()
+{
+    QStringList report;
+    const QHash<QString,QueryTiming> &timings = store().timings;
+    for(QHash<QString,QueryTiming>::const_iterator it = timings.constBegin(); it != timings.constEnd(); ++it)
+    {
+        const QueryTiming &t = it.value();
+        report << QString("%1 calls, %2 ms total, %3 ms max: %4")
+                  .arg(t.calls)
+                  .arg(t.totalNs / 1000000.0, 0, 'f', 2)
+                  .arg(t.maxNs / 1000000.0, 0, 'f', 2)
+                  .arg(it.key().simplified());
+    }
+    return report;
+}
+
+void SqlStatementCache::clear()
+{
+    StatementStore &s = store();
+    qDeleteAll(s.statements);
+    s.statements.clear();
+    s.timings.clear();
+}
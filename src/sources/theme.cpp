@@ -22,6 +22,7 @@
 #include <QSqlError>
 #include <QDebug>
 #include <QFile>
+#include "../headers/sqlstatementcache.hpp"
 
 void migrateThemeTablesForVideoBackgrounds()
 {
@@ -455,11 +456,14 @@ void Theme::loadTheme()
 
 void Theme::loadPassive(int screen, TextSettings &settings)
 {
-    QSqlQuery sq;
     QSqlRecord sr;
-    sq.exec(QString("SELECT * FROM ThemePassive WHERE theme_id = %1 and disp = %2").arg(m_info.themeId).arg(screen));
+    QSqlQuery &sq = SqlStatementCache::query("SELECT * FROM ThemePassive WHERE theme_id = ? and disp = ?");
+    sq.addBindValue(m_info.themeId);
+    sq.addBindValue(screen);
+    SqlStatementCache::exec(sq);
     sq.first();
     sr = sq.record();
+    sq.finish();
     settings.useBackground = sr.field("use_background").value().toBool();
     settings.backgroundName = sr.field("background_name").value().toString();
     settings.backgroundPix.loadFromData(sr.field("background").value().toByteArray());
@@ -482,11 +486,14 @@ void Theme::loadPassive(int screen, TextSettings &settings)
 
 void Theme::loadBible(int screen, BibleSettings &settings)
 {
-    QSqlQuery sq;
     QSqlRecord sr;
-    sq.exec(QString("SELECT * FROM ThemeBible WHERE theme_id = %1 and disp = %2").arg(m_info.themeId).arg(screen));
+    QSqlQuery &sq = SqlStatementCache::query("SELECT * FROM ThemeBible WHERE theme_id = ? and disp = ?");
+    sq.addBindValue(m_info.themeId);
+    sq.addBindValue(screen);
+    SqlStatementCache::exec(sq);
     sq.first();
     sr = sq.record();
+    sq.finish();
     settings.useShadow = sr.field("use_shadow").value().toBool();
     settings.useFading = sr.field("use_fading").value().toBool();
     settings.useBlurShadow = sr.field("use_blur_shadow").value().toBool();
@@ -526,11 +533,14 @@ void Theme::loadBible(int screen, BibleSettings &settings)
 
 void Theme::loadSong(int screen, SongSettings &settings)
 {
-    QSqlQuery sq;
     QSqlRecord sr;
-    sq.exec(QString("SELECT * FROM ThemeSong WHERE theme_id = %1 and disp = %2").arg(m_info.themeId).arg(screen));
+    QSqlQuery &sq = SqlStatementCache::query("SELECT * FROM ThemeSong WHERE theme_id = ? and disp = ?");
+    sq.addBindValue(m_info.themeId);
+    sq.addBindValue(screen);
+    SqlStatementCache::exec(sq);
     sq.first();
     sr = sq.record();
+    sq.finish();
     settings.useShadow = sr.field("use_shadow").value().toBool();
     settings.useFading = sr.field("use_fading").value().toBool();
     settings.useBlurShadow = sr.field("use_blur_shadow").value().toBool();
@@ -576,11 +586,14 @@ void Theme::loadSong(int screen, SongSettings &settings)
 
 void Theme::loadAnnounce(int screen, TextSettings &settings)
 {
-    QSqlQuery sq;
     QSqlRecord sr;
-    sq.exec(QString("SELECT * FROM ThemeAnnounce WHERE theme_id = %1 and disp = %2").arg(m_info.themeId).arg(screen));
+    QSqlQuery &sq = SqlStatementCache::query("SELECT * FROM ThemeAnnounce WHERE theme_id = ? and disp = ?");
+    sq.addBindValue(m_info.themeId);
+    sq.addBindValue(screen);
+    SqlStatementCache::exec(sq);
     sq.first();
     sr = sq.record();
+    sq.finish();
     settings.useShadow = sr.field("use_shadow").value().toBool();
     settings.useFading = sr.field("use_fading").value().toBool();
     settings.useBlurShadow = sr.field("use_blur_shadow").value().toBool();
@@ -20,25 +20,112 @@
 #include "../headers/virtualoutput.hpp"
 
 #include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
-#include <QHostAddress>
 #include <QImage>
+#include <QImageWriter>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QKeyEvent>
-#include <QMimeDatabase>
+#include <QPainter>
+#include <QtMath>
 #include <QTextStream>
 #include <QUrl>
+#include <QtConcurrent>
 
 namespace
 {
 const quint16 kVirtualOutputHttpPort = 15171;
 const quint16 kVirtualOutputWebSocketPort = 15172;
-const char *kVirtualOutputPage = ":/web/virtualoutput.html";
-const char *kVirtualOutputScript = ":/web/virtualoutput.js";
-const char *kVirtualOutputStyle = ":/web/virtualoutput.css";
+
+// QImageWriter maps PNG quality 80 to zlib level 1
+const int kFastPngQuality = 80;
+const int kJpegQuality = 90;
+const int kWebpQuality = 85;
+
+// Text layers are compared against the previous slide in tiles of this size
+const int kTextTileSize = 64;
+
+// Encoded backgrounds kept for reuse, in KB
+const int kBackgroundCacheBudget = 16 * 1024;
+
+bool isOpaque(const QImage &image)
+{
+    if (!image.hasAlphaChannel()) {
+        return true;
+    }
+
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+    for (int y = 0; y < argb.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        for (int x = 0; x < argb.width(); ++x) {
+            if (qAlpha(line[x]) != 255) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+QByteArray writeImage(QImage image, int codec, QString *contentType)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, QByteArray());
+    switch (codec) {
+    case VirtualOutput::CODEC_JPEG:
+        writer.setFormat("jpeg");
+        writer.setQuality(kJpegQuality);
+        *contentType = QStringLiteral("image/jpeg");
+        image = image.convertToFormat(QImage::Format_RGB32);
+        break;
+    case VirtualOutput::CODEC_WEBP:
+        writer.setFormat("webp");
+        writer.setQuality(kWebpQuality);
+        *contentType = QStringLiteral("image/webp");
+        break;
+    case VirtualOutput::CODEC_PNG_FAST:
+        writer.setFormat("png");
+        writer.setQuality(kFastPngQuality);
+        *contentType = QStringLiteral("image/png");
+        break;
+    case VirtualOutput::CODEC_PNG:
+    default:
+        writer.setFormat("png");
+        *contentType = QStringLiteral("image/png");
+        break;
+    }
+
+    if (!writer.write(image)) {
+        data.clear();
+    }
+    return data;
+}
+
+// Identifies an image by its pixels. Reloaded themes and songs hand out new
+// pixmaps of the same picture, whose cache keys never match the old ones.
+QString contentKey(const QImage &image)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    const int lineBytes = (image.width() * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y) {
+        hash.addData(QByteArray::fromRawData(reinterpret_cast<const char*>(image.constScanLine(y)), lineBytes));
+    }
+    return QString("%1:%2x%3:%4").arg(QString::fromLatin1(hash.result().toHex()))
+            .arg(image.width()).arg(image.height()).arg(int(image.format()));
+}
+
+bool webpSupported()
+{
+    static const bool supported = QImageWriter::supportedImageFormats().contains("webp");
+    return supported;
+}
 }
 
 VirtualOutput::VirtualOutput(QObject *parent)
@@ -49,8 +136,14 @@ VirtualOutput::VirtualOutput(QObject *parent)
       m_themeId(-1),
       m_resolutionPreset(RES_1080P),
       m_resolution(1920, 1080),
-      m_httpServer(nullptr),
-      m_webSocketServer(nullptr),
+      m_server(new VirtualOutputServer),
+      m_backgroundCodec(CODEC_JPEG),
+      m_textCodec(CODEC_PNG_FAST),
+      m_backgroundPixmapKey(-1),
+      m_sceneBackgroundFill(0),
+      m_streamFrameRate(30),
+      m_pendingEncodes(0),
+      m_statePending(false),
       m_mediaVersion(0),
       m_transitionType(TR_NONE),
       m_backgroundVideoLoop(true),
@@ -62,12 +155,29 @@ VirtualOutput::VirtualOutput(QObject *parent)
       m_mainVideoMuted(false)
 {
     m_color.setRgb(0, 0, 0, 0);
+    m_backgroundColor = m_color;
+    m_backgroundCache.setMaxCost(kBackgroundCacheBudget);
+
+    // Asset versions restart with the application, the session tag keeps
+    // URLs cached by browsers in an earlier run from being reused
+    m_sessionTag = QByteArray::number(QDateTime::currentMSecsSinceEpoch(), 36);
     m_imageGenerator.setScreenSize(m_resolution);
+
+    // Sockets live on their own thread, so slow clients never hold up
+    // rendering. They only get immutable snapshots through queued signals.
+    qRegisterMetaType<VirtualOutputSnapshotPtr>("VirtualOutputSnapshotPtr");
+    m_networkThread.setObjectName(QStringLiteral("VirtualOutputNetwork"));
+    m_server->moveToThread(&m_networkThread);
+    connect(this, SIGNAL(snapshotReady(VirtualOutputSnapshotPtr)),
+            m_server, SLOT(publish(VirtualOutputSnapshotPtr)), Qt::QueuedConnection);
 }
 
 VirtualOutput::~VirtualOutput()
 {
     stopServers();
+    m_networkThread.quit();
+    m_networkThread.wait();
+    delete m_server;
 }
 
 quint16 VirtualOutput::httpPort()
@@ -87,7 +197,7 @@ QString VirtualOutput::browserUrl()
 
 bool VirtualOutput::initialize()
 {
-    if (m_initialized && m_httpServer && m_webSocketServer) {
+    if (m_initialized) {
         return true;
     }
 
@@ -101,66 +211,22 @@ bool VirtualOutput::initialize()
 
 bool VirtualOutput::startServers()
 {
-    stopServers();
-
-    m_httpServer = new QTcpServer(this);
-    connect(m_httpServer, SIGNAL(newConnection()), this, SLOT(onNewHttpConnection()));
-
-    if (!m_httpServer->listen(QHostAddress::LocalHost, httpPort())) {
-        qWarning() << "Failed to start virtual output HTTP server:" << m_httpServer->errorString();
-        delete m_httpServer;
-        m_httpServer = nullptr;
-        return false;
+    if (!m_networkThread.isRunning()) {
+        m_networkThread.start();
     }
 
-    m_webSocketServer = new QWebSocketServer(QStringLiteral("softProjector Virtual Output"),
-                                             QWebSocketServer::NonSecureMode, this);
-    connect(m_webSocketServer, SIGNAL(newConnection()), this, SLOT(onNewWebSocketConnection()));
-
-    if (!m_webSocketServer->listen(QHostAddress::LocalHost, websocketPort())) {
-        qWarning() << "Failed to start virtual output WebSocket server:" << m_webSocketServer->errorString();
-        m_httpServer->close();
-        delete m_httpServer;
-        m_httpServer = nullptr;
-        delete m_webSocketServer;
-        m_webSocketServer = nullptr;
-        return false;
-    }
-
-    return true;
+    bool started = false;
+    QMetaObject::invokeMethod(m_server, "start", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(bool, started),
+                              Q_ARG(int, httpPort()), Q_ARG(int, websocketPort()));
+    return started;
 }
 
 void VirtualOutput::stopServers()
 {
-    foreach (QWebSocket *client, m_clients) {
-        if (client) {
-            client->close();
-            client->deleteLater();
-        }
+    if (m_networkThread.isRunning()) {
+        QMetaObject::invokeMethod(m_server, "stop", Qt::BlockingQueuedConnection);
     }
-    m_clients.clear();
-
-    foreach (QTcpSocket *socket, m_httpSockets) {
-        if (socket) {
-            socket->disconnect(this);
-            socket->close();
-            socket->deleteLater();
-        }
-    }
-    m_httpSockets.clear();
-
-    if (m_httpServer) {
-        m_httpServer->close();
-        m_httpServer->deleteLater();
-        m_httpServer = nullptr;
-    }
-
-    if (m_webSocketServer) {
-        m_webSocketServer->close();
-        m_webSocketServer->deleteLater();
-        m_webSocketServer = nullptr;
-    }
-
     m_initialized = false;
 }
 
@@ -225,6 +291,49 @@ void VirtualOutput::setTheme(bool mirrorDisplay1, int themeId)
     emit themeChanged(m_mirrorDisplay1, m_themeId);
 }
 
+void VirtualOutput::setBackgroundCodec(AssetCodec codec)
+{
+    if (codec == CODEC_WEBP && !webpSupported()) {
+        qWarning() << "WebP image plugin not available, virtual output backgrounds use JPEG";
+        codec = CODEC_JPEG;
+    }
+    m_backgroundCodec = codec;
+}
+
+void VirtualOutput::setTextCodec(AssetCodec codec)
+{
+    if (codec == CODEC_WEBP && !webpSupported()) {
+        codec = CODEC_JPEG;
+    }
+    m_textCodec = codec;
+}
+
+void VirtualOutput::setStreamFrameRate(int fps)
+{
+    fps = qBound(1, fps, 60);
+    if (m_streamFrameRate == fps) {
+        return;
+    }
+    m_streamFrameRate = fps;
+    broadcastState();
+}
+
+QString VirtualOutput::encodeStatistics() const
+{
+    return QString("Virtual output encodes: %1; %2")
+            .arg(assetStatistics(QStringLiteral("background"), m_backgroundImage))
+            .arg(assetStatistics(QStringLiteral("text"), m_textImage));
+}
+
+QString VirtualOutput::assetStatistics(const QString &name, const AssetState &asset) const
+{
+    const qint64 count = qMax<qint64>(1, asset.encodeCount);
+    return QString("%1 %2 images, last %3 ms %4 KB, average %5 ms %6 KB")
+            .arg(name).arg(asset.encodeCount)
+            .arg(asset.encodeNanoseconds / 1e6, 0, 'f', 2).arg(asset.data.size() / 1024)
+            .arg(asset.totalEncodeNanoseconds / 1e6 / count, 0, 'f', 2).arg(asset.totalBytes / 1024 / count);
+}
+
 void VirtualOutput::setLogoOverlay(const QString &imagePath)
 {
     m_logoImagePath = imagePath;
@@ -266,34 +375,218 @@ void VirtualOutput::setTransition(int transitionType)
 
 void VirtualOutput::setBackPixmap(const QPixmap &pixmap, int fillMode)
 {
-    QPixmap scaled = pixmap;
+    // Themes reuse one background for every verse and stanza, so keep the
+    // published bytes and version unless the picture or its output changed.
+    // Only a pixmap not seen last time has its pixels hashed, and the stream
+    // keeps its scaled copy while the scene image stays the same.
+    if (pixmap.cacheKey() != m_backgroundPixmapKey) {
+        const QImage image = pixmap.toImage();
+        const QString content = contentKey(image);
+        m_backgroundPixmapKey = pixmap.cacheKey();
+        if (content != m_backgroundContentKey || m_sceneBackground.isNull()) {
+            m_backgroundContentKey = content;
+            m_sceneBackground = image;
+        }
+    }
+    const QString key = QString("%1:%2:%3x%4:%5").arg(m_backgroundContentKey).arg(fillMode)
+            .arg(m_resolution.width()).arg(m_resolution.height()).arg(int(m_backgroundCodec));
+    if (key == m_backgroundImage.sourceKey) {
+        return;
+    }
+    m_backgroundImage.sourceKey = key;
+    m_sceneBackgroundFill = fillMode;
+
+    const EncodedAsset *cached = m_backgroundCache.object(key);
+    if (cached) {
+        ++m_backgroundImage.serial;
+        publishAsset(&m_backgroundImage, *cached);
+        return;
+    }
+
+    // Scaling happens with the encode on the worker, pixmaps stay on this thread
+    encodeAsset(&m_backgroundImage, m_sceneBackground, fillMode, m_backgroundCodec, key);
+}
+
+void VirtualOutput::setBackColor(const QColor &color)
+{
+    // Solid colors go into the state as CSS, there is nothing to encode or download
+    const QString key = QStringLiteral("color:") + QString::number(color.rgba(), 16);
+    if (key == m_backgroundImage.sourceKey) {
+        return;
+    }
+    m_backgroundImage.sourceKey = key;
+    ++m_backgroundImage.serial;
+
+    m_backgroundColor = color;
+    m_sceneBackground = QImage();
+    m_backgroundPixmapKey = -1;
+    m_backgroundImage.data.clear();
+    m_backgroundImage.contentType.clear();
+    m_backgroundImage.available = false;
+}
 
+void VirtualOutput::setTextPixmap(const QPixmap &pixmap)
+{
+    setTextImage(pixmap.toImage());
+}
+
+void VirtualOutput::setTextImage(const QImage &image)
+{
+    // Text images only cover the text, offset() is where they go on the screen.
+    // With the same placement as the previous slide the changed tiles are
+    // encoded as well, for pages still showing that slide.
+    QImage previous;
+    quint64 base = 0;
+    if (!m_lastTextImage.isNull() && m_lastTextImage.offset() == image.offset()
+            && m_lastTextImage.size() == image.size() && m_lastTextImage.format() == image.format()) {
+        previous = m_lastTextImage;
+        base = m_textImage.serial;
+    }
+    m_lastTextImage = image;
+    encodeAsset(&m_textImage, image, -1, m_textCodec, QString(), previous, base);
+}
+
+VirtualOutput::EncodedAsset VirtualOutput::encodeImage(const QImage &image, const QSize &size,
+                                                       int fillMode, int codec, const QImage &previous)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QImage scaled = image;
     switch (fillMode) {
     case 0:
-        scaled = pixmap.scaled(m_resolution, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        scaled = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
         break;
     case 1:
-        scaled = pixmap.scaled(m_resolution, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        scaled = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
         break;
     case 2:
-        scaled = pixmap.scaled(m_resolution, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+        scaled = image.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
         break;
     default:
         break;
     }
 
-    m_backgroundImage.data = pixmapToPng(scaled);
-    m_backgroundImage.contentType = QStringLiteral("image/png");
-    m_backgroundImage.available = !m_backgroundImage.data.isEmpty();
-    ++m_backgroundImage.version;
+    if ((codec == CODEC_JPEG || codec == CODEC_WEBP) && !isOpaque(scaled)) {
+        codec = CODEC_PNG_FAST;
+    }
+
+    EncodedAsset encoded;
+    encoded.data = writeImage(scaled, codec, &encoded.contentType);
+    encoded.rect = QRect(image.offset(), scaled.size());
+    if (!previous.isNull()) {
+        encodeTextDelta(image, previous, &encoded.delta);
+    }
+    encoded.nanoseconds = timer.nsecsElapsed();
+    return encoded;
 }
 
-void VirtualOutput::setTextPixmap(const QPixmap &pixmap)
+void VirtualOutput::encodeTextDelta(const QImage &image, const QImage &previous, TextDelta *delta)
 {
-    m_textImage.data = pixmapToPng(pixmap);
-    m_textImage.contentType = QStringLiteral("image/png");
-    m_textImage.available = !m_textImage.data.isEmpty();
-    ++m_textImage.version;
+    // Compare tile by tile against the previous slide. Give up when most of
+    // the layer changed, the full image is about as small then.
+    const int pixelBytes = image.depth() / 8;
+    for (int ty = 0; ty < image.height(); ty += kTextTileSize) {
+        const int h = qMin(kTextTileSize, image.height() - ty);
+        for (int tx = 0; tx < image.width(); tx += kTextTileSize) {
+            const int w = qMin(kTextTileSize, image.width() - tx);
+            const int offset = tx * pixelBytes;
+            const int bytes = w * pixelBytes;
+            for (int y = ty; y < ty + h; ++y) {
+                if (memcmp(image.constScanLine(y) + offset, previous.constScanLine(y) + offset, bytes) != 0) {
+                    delta->tiles.append(QRect(tx, ty, w, h));
+                    break;
+                }
+            }
+        }
+    }
+
+    qint64 changedArea = 0;
+    foreach (const QRect &tile, delta->tiles) {
+        changedArea += qint64(tile.width()) * tile.height();
+    }
+    if (changedArea * 2 >= qint64(image.width()) * image.height()) {
+        delta->tiles.clear();
+        return;
+    }
+
+    // Changed tiles are packed into an atlas, tile i goes to cell i of a
+    // grid with the given number of columns
+    const int count = delta->tiles.count();
+    delta->columns = qMax(1, qCeil(qSqrt(count)));
+    const int rows = qMax(1, (count + delta->columns - 1) / delta->columns);
+    QImage atlas(delta->columns * kTextTileSize, rows * kTextTileSize, QImage::Format_ARGB32_Premultiplied);
+    atlas.fill(Qt::transparent);
+    QPainter painter(&atlas);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (int i(0); i < count; ++i) {
+        const QRect &tile = delta->tiles.at(i);
+        painter.drawImage(QPoint((i % delta->columns) * kTextTileSize, (i / delta->columns) * kTextTileSize),
+                          image, tile);
+    }
+    painter.end();
+
+    QString contentType;
+    delta->data = writeImage(atlas, CODEC_PNG_FAST, &contentType);
+}
+
+void VirtualOutput::encodeAsset(AssetState *asset, const QImage &image, int fillMode, AssetCodec codec,
+                                const QString &cacheKey, const QImage &previous, quint64 deltaBase)
+{
+    const quint64 serial = ++asset->serial;
+    QFutureWatcher<EncodedAsset> *watcher = new QFutureWatcher<EncodedAsset>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, asset, serial, cacheKey, deltaBase]() {
+        EncodedAsset encoded = watcher->result();
+        encoded.delta.base = deltaBase;
+        finishEncode(asset, serial, cacheKey, encoded);
+        watcher->deleteLater();
+    });
+
+    ++m_pendingEncodes;
+    watcher->setFuture(QtConcurrent::run(QThreadPool::globalInstance(), &VirtualOutput::encodeImage,
+                                         image, m_resolution, fillMode, int(codec), previous));
+}
+
+void VirtualOutput::finishEncode(AssetState *asset, quint64 serial, const QString &cacheKey,
+                                 const EncodedAsset &encoded)
+{
+    --m_pendingEncodes;
+
+    asset->encodeNanoseconds = encoded.nanoseconds;
+    asset->totalEncodeNanoseconds += encoded.nanoseconds;
+    asset->totalBytes += encoded.data.size();
+    ++asset->encodeCount;
+
+    // Serials are unique per asset, so they double as versions. A cached
+    // asset keeps its version, and clients that still hold that URL skip
+    // the download when it comes back.
+    EncodedAsset published = encoded;
+    published.version = serial;
+    if (!cacheKey.isEmpty() && !encoded.data.isEmpty()) {
+        m_backgroundCache.insert(cacheKey, new EncodedAsset(published), encoded.data.size() / 1024 + 1);
+    }
+
+    // A newer image was queued while this one encoded, only the newest is published
+    if (serial == asset->serial) {
+        publishAsset(asset, published);
+        if (encoded.data.isEmpty()) {
+            asset->sourceKey.clear();
+        }
+    }
+
+    if (m_pendingEncodes == 0 && m_statePending) {
+        broadcastState();
+    }
+}
+
+void VirtualOutput::publishAsset(AssetState *asset, const EncodedAsset &encoded)
+{
+    asset->data = encoded.data;
+    asset->contentType = encoded.contentType;
+    asset->rect = encoded.rect;
+    asset->delta = encoded.delta;
+    asset->available = !asset->data.isEmpty();
+    asset->version = encoded.version;
 }
 
 void VirtualOutput::renderPassiveText(QPixmap &background, bool useBackground, TextSettings &pSets)
@@ -313,7 +606,7 @@ void VirtualOutput::renderPassiveText(QPixmap &background, bool useBackground, T
         if (useBackground) {
             setBackPixmap(background, 0);
         } else {
-            setBackPixmap(m_imageGenerator.generateColorImage(m_color), 0);
+            setBackColor(m_color);
         }
     }
 
@@ -336,11 +629,11 @@ void VirtualOutput::renderBibleText(Verse verse, BibleSettings &settings)
         if (settings.useBackground) {
             setBackPixmap(settings.backgroundPix, 0);
         } else {
-            setBackPixmap(m_imageGenerator.generateColorImage(m_color), 0);
+            setBackColor(m_color);
         }
     }
 
-    setTextPixmap(m_imageGenerator.generateBibleImage(verse, settings));
+    setTextImage(m_imageGenerator.generateBibleImage(verse, settings));
     updateDisplay();
 }
 
@@ -360,11 +653,11 @@ void VirtualOutput::renderSongText(Stanza stanza, SongSettings &settings)
         if (settings.useBackground) {
             setBackPixmap(settings.backgroundPix, 0);
         } else {
-            setBackPixmap(m_imageGenerator.generateColorImage(m_color), 0);
+            setBackColor(m_color);
         }
     }
 
-    setTextPixmap(m_imageGenerator.generateSongImage(stanza, settings));
+    setTextImage(m_imageGenerator.generateSongImage(stanza, settings));
     updateDisplay();
 }
 
@@ -384,14 +677,35 @@ void VirtualOutput::renderAnnounceText(AnnounceSlide announce, TextSettings &set
         if (settings.useBackground) {
             setBackPixmap(settings.backgroundPix, 0);
         } else {
-            setBackPixmap(m_imageGenerator.generateColorImage(m_color), 0);
+            setBackColor(m_color);
         }
     }
 
-    setTextPixmap(m_imageGenerator.generateAnnounceImage(announce, settings));
+    setTextImage(m_imageGenerator.generateAnnounceImage(announce, settings));
     updateDisplay();
 }
 
+void VirtualOutput::prerenderBibleText(Verse verse, BibleSettings &settings)
+{
+    if (m_enabled) {
+        m_imageGenerator.prerenderBibleImage(verse, settings);
+    }
+}
+
+void VirtualOutput::prerenderSongText(Stanza stanza, SongSettings &settings)
+{
+    if (m_enabled) {
+        m_imageGenerator.prerenderSongImage(stanza, settings);
+    }
+}
+
+void VirtualOutput::prerenderAnnounceText(AnnounceSlide announce, TextSettings &settings)
+{
+    if (m_enabled) {
+        m_imageGenerator.prerenderAnnounceImage(announce, settings);
+    }
+}
+
 void VirtualOutput::renderSlideShow(QPixmap slide, SlideShowSettings &settings)
 {
     if (!m_enabled) {
@@ -420,7 +734,7 @@ void VirtualOutput::renderVideo(VideoInfo videoDetails)
     stopBackgroundVideo();
     setTransition(TR_NONE);
     setTextPixmap(m_imageGenerator.generateEmptyImage());
-    setBackPixmap(m_imageGenerator.generateColorImage(m_color), 0);
+    setBackColor(m_color);
 
     const QString path = localFilePath(videoDetails.filePath);
     if (path != m_mainVideoPath) {
@@ -561,6 +875,7 @@ void VirtualOutput::updateOverlayAsset()
     m_overlayImage.data.clear();
     m_overlayImage.contentType.clear();
     ++m_overlayImage.version;
+    m_sceneOverlay = QImage();
 
     if (m_logoImagePath.isEmpty()) {
         return;
@@ -572,27 +887,12 @@ void VirtualOutput::updateOverlayAsset()
     }
 
     m_overlayImage.data = file.readAll();
-    m_overlayImage.contentType = contentTypeForFile(m_logoImagePath);
+    m_overlayImage.contentType = VirtualOutputServer::contentTypeForFile(m_logoImagePath);
     if (m_overlayImage.contentType.isEmpty()) {
         m_overlayImage.contentType = QStringLiteral("application/octet-stream");
     }
     m_overlayImage.available = !m_overlayImage.data.isEmpty();
-}
-
-QByteArray VirtualOutput::pixmapToPng(const QPixmap &pixmap) const
-{
-    QByteArray png;
-    QBuffer buffer(&png);
-    buffer.open(QIODevice::WriteOnly);
-    pixmap.save(&buffer, "PNG");
-    return png;
-}
-
-QString VirtualOutput::contentTypeForFile(const QString &path) const
-{
-    QMimeDatabase db;
-    const QMimeType mime = db.mimeTypeForFile(path);
-    return mime.isValid() ? mime.name() : QString();
+    m_sceneOverlay = QImage::fromData(m_overlayImage.data);
 }
 
 QString VirtualOutput::localFilePath(const QUrl &url) const
@@ -612,20 +912,46 @@ void VirtualOutput::broadcastState()
         return;
     }
 
-    const QByteArray state = buildStateMessage();
-    foreach (QWebSocket *client, m_clients) {
-        if (client && client->isValid()) {
-            client->sendTextMessage(QString::fromUtf8(state));
-        }
+    // Clients fetch the assets named in the state, so wait until they are encoded
+    if (m_pendingEncodes > 0) {
+        m_statePending = true;
+        return;
     }
+    m_statePending = false;
+
+    VirtualOutputSnapshot *snapshot = new VirtualOutputSnapshot;
+    snapshot->state = buildStateMessage();
+    snapshot->background = snapshotAsset(m_backgroundImage);
+    snapshot->text = snapshotAsset(m_textImage);
+    if (!m_textImage.delta.data.isEmpty()) {
+        snapshot->textDelta.data = m_textImage.delta.data;
+        snapshot->textDelta.contentType = "image/png";
+        snapshot->textDelta.tag = snapshot->text.tag;
+        snapshot->textDelta.baseTag = versionTag(m_textImage.delta.base);
+        snapshot->textDelta.available = true;
+    }
+    snapshot->overlay = snapshotAsset(m_overlayImage);
+    snapshot->mainVideoPath = m_mainVideoPath;
+    snapshot->backgroundVideoPath = m_backgroundVideoPath;
+    snapshot->scene.background = m_backgroundVideoPath.isEmpty() ? m_sceneBackground : QImage();
+    snapshot->scene.fillMode = m_sceneBackgroundFill;
+    snapshot->scene.color = m_backgroundColor;
+    snapshot->scene.text = m_lastTextImage;
+    snapshot->scene.overlay = m_sceneOverlay;
+    snapshot->scene.size = m_resolution;
+    snapshot->scene.frameRate = m_streamFrameRate;
+    snapshot->scene.fade = (m_transitionType == TR_FADE);
+    emit snapshotReady(VirtualOutputSnapshotPtr(snapshot));
 }
 
-void VirtualOutput::sendState(QWebSocket *socket)
+VirtualOutputAsset VirtualOutput::snapshotAsset(const AssetState &asset) const
 {
-    if (!socket || !socket->isValid() || !m_enabled) {
-        return;
-    }
-    socket->sendTextMessage(QString::fromUtf8(buildStateMessage()));
+    VirtualOutputAsset snapshot;
+    snapshot.data = asset.data;
+    snapshot.contentType = asset.contentType.toUtf8();
+    snapshot.tag = assetTag(asset);
+    snapshot.available = asset.available;
+    return snapshot;
 }
 
 QByteArray VirtualOutput::buildStateMessage() const
@@ -638,20 +964,40 @@ QByteArray VirtualOutput::buildStateMessage() const
 
     QJsonObject background;
     background.insert(QStringLiteral("enabled"), m_backgroundImage.available);
-    background.insert(QStringLiteral("version"), QString::number(m_backgroundImage.version));
-    background.insert(QStringLiteral("url"), QString("/assets/background.png?v=%1").arg(m_backgroundImage.version));
+    background.insert(QStringLiteral("version"), QString::fromLatin1(assetTag(m_backgroundImage)));
+    background.insert(QStringLiteral("url"), QString("/assets/background?v=%1").arg(QString::fromLatin1(assetTag(m_backgroundImage))));
     root.insert(QStringLiteral("backgroundImage"), background);
+    root.insert(QStringLiteral("backgroundColor"), QString("rgba(%1, %2, %3, %4)")
+                .arg(m_backgroundColor.red()).arg(m_backgroundColor.green()).arg(m_backgroundColor.blue())
+                .arg(m_backgroundColor.alphaF()));
 
     QJsonObject text;
     text.insert(QStringLiteral("enabled"), m_textImage.available);
-    text.insert(QStringLiteral("version"), QString::number(m_textImage.version));
-    text.insert(QStringLiteral("url"), QString("/assets/text.png?v=%1").arg(m_textImage.version));
+    text.insert(QStringLiteral("version"), QString::fromLatin1(assetTag(m_textImage)));
+    text.insert(QStringLiteral("url"), QString("/assets/text?v=%1").arg(QString::fromLatin1(assetTag(m_textImage))));
+    text.insert(QStringLiteral("x"), m_textImage.rect.x());
+    text.insert(QStringLiteral("y"), m_textImage.rect.y());
+    text.insert(QStringLiteral("width"), m_textImage.rect.width());
+    text.insert(QStringLiteral("height"), m_textImage.rect.height());
+    if (!m_textImage.delta.data.isEmpty()) {
+        QJsonArray tiles;
+        foreach (const QRect &tile, m_textImage.delta.tiles) {
+            tiles.append(QJsonArray() << tile.x() << tile.y() << tile.width() << tile.height());
+        }
+        QJsonObject delta;
+        delta.insert(QStringLiteral("base"), QString::fromLatin1(versionTag(m_textImage.delta.base)));
+        delta.insert(QStringLiteral("url"), QString("/assets/textdelta?v=%1").arg(QString::fromLatin1(assetTag(m_textImage))));
+        delta.insert(QStringLiteral("tileSize"), kTextTileSize);
+        delta.insert(QStringLiteral("columns"), m_textImage.delta.columns);
+        delta.insert(QStringLiteral("tiles"), tiles);
+        text.insert(QStringLiteral("delta"), delta);
+    }
     root.insert(QStringLiteral("textImage"), text);
 
     QJsonObject overlay;
     overlay.insert(QStringLiteral("enabled"), m_overlayImage.available);
-    overlay.insert(QStringLiteral("version"), QString::number(m_overlayImage.version));
-    overlay.insert(QStringLiteral("url"), QString("/assets/overlay?v=%1").arg(m_overlayImage.version));
+    overlay.insert(QStringLiteral("version"), QString::fromLatin1(assetTag(m_overlayImage)));
+    overlay.insert(QStringLiteral("url"), QString("/assets/overlay?v=%1").arg(QString::fromLatin1(assetTag(m_overlayImage))));
     root.insert(QStringLiteral("overlay"), overlay);
 
     QJsonObject backgroundVideo;
@@ -675,290 +1021,14 @@ QByteArray VirtualOutput::buildStateMessage() const
     return QJsonDocument(root).toJson(QJsonDocument::Compact);
 }
 
-void VirtualOutput::onNewHttpConnection()
-{
-    if (!m_httpServer) {
-        return;
-    }
-
-    while (m_httpServer->hasPendingConnections()) {
-        QTcpSocket *socket = m_httpServer->nextPendingConnection();
-        m_httpSockets.insert(socket);
-        connect(socket, SIGNAL(readyRead()), this, SLOT(onSocketReadyRead()));
-        connect(socket, SIGNAL(disconnected()), this, SLOT(onSocketDisconnected()));
-    }
-}
-
-void VirtualOutput::onSocketReadyRead()
-{
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) {
-        return;
-    }
-
-    QByteArray requestData = socket->property("requestBuffer").toByteArray();
-    requestData += socket->readAll();
-    if (!requestData.contains("\r\n\r\n")) {
-        socket->setProperty("requestBuffer", requestData);
-        return;
-    }
-
-    socket->setProperty("requestBuffer", QByteArray());
-
-    handleHttpRequest(socket, requestData);
-}
-
-void VirtualOutput::onSocketDisconnected()
-{
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) {
-        return;
-    }
-    m_httpSockets.remove(socket);
-    socket->deleteLater();
-}
-
-void VirtualOutput::onNewWebSocketConnection()
-{
-    if (!m_webSocketServer) {
-        return;
-    }
-
-    QWebSocket *socket = m_webSocketServer->nextPendingConnection();
-    if (!socket) {
-        return;
-    }
-
-    connect(socket, SIGNAL(disconnected()), this, SLOT(onWebSocketDisconnected()));
-    m_clients.insert(socket);
-    sendState(socket);
-}
-
-void VirtualOutput::onWebSocketDisconnected()
-{
-    QWebSocket *socket = qobject_cast<QWebSocket*>(sender());
-    if (!socket) {
-        return;
-    }
-    m_clients.remove(socket);
-    socket->deleteLater();
-}
-
-void VirtualOutput::resetHttpSocket(QTcpSocket *socket)
-{
-    if (!socket) {
-        return;
-    }
-    socket->disconnectFromHost();
-}
-
-void VirtualOutput::handleHttpRequest(QTcpSocket *socket, const QByteArray &requestData)
-{
-    const QList<QByteArray> sections = requestData.split('\n');
-    if (sections.isEmpty()) {
-        sendBadRequest(socket);
-        return;
-    }
-
-    const QByteArray requestLine = sections.first().trimmed();
-    const QList<QByteArray> requestParts = requestLine.split(' ');
-    if (requestParts.size() < 2) {
-        sendBadRequest(socket);
-        return;
-    }
-
-    const QByteArray method = requestParts.at(0);
-    const bool sendBody = (method != "HEAD");
-    if (method != "GET" && method != "HEAD") {
-        sendMethodNotAllowed(socket);
-        return;
-    }
-
-    QByteArray rangeHeader;
-    for (int i = 1; i < sections.count(); ++i) {
-        const QByteArray line = sections.at(i).trimmed();
-        if (line.startsWith("Range:")) {
-            rangeHeader = line.mid(QByteArray("Range:").size()).trimmed();
-        }
-    }
-
-    const QUrl url = QUrl::fromEncoded(requestParts.at(1));
-    const QString path = url.path().isEmpty() ? QStringLiteral("/") : url.path();
-
-    if (path == QStringLiteral("/") || path == QStringLiteral("/index.html")) {
-        QFile file(QString::fromLatin1(kVirtualOutputPage));
-        if (!file.open(QIODevice::ReadOnly)) {
-            sendNotFound(socket);
-            return;
-        }
-        const QByteArray body = file.readAll();
-        sendHttpResponse(socket, "HTTP/1.1 200 OK", "text/html; charset=utf-8", body, QList<QByteArray>(), sendBody, body.size());
-        return;
-    }
-
-    if (path == QStringLiteral("/virtualoutput.js")) {
-        QFile file(QString::fromLatin1(kVirtualOutputScript));
-        if (!file.open(QIODevice::ReadOnly)) {
-            sendNotFound(socket);
-            return;
-        }
-        const QByteArray body = file.readAll();
-        sendHttpResponse(socket, "HTTP/1.1 200 OK", "application/javascript; charset=utf-8", body, QList<QByteArray>(), sendBody, body.size());
-        return;
-    }
-
-    if (path == QStringLiteral("/virtualoutput.css")) {
-        QFile file(QString::fromLatin1(kVirtualOutputStyle));
-        if (!file.open(QIODevice::ReadOnly)) {
-            sendNotFound(socket);
-            return;
-        }
-        const QByteArray body = file.readAll();
-        sendHttpResponse(socket, "HTTP/1.1 200 OK", "text/css; charset=utf-8", body, QList<QByteArray>(), sendBody, body.size());
-        return;
-    }
-
-    if (path == QStringLiteral("/assets/background.png")) {
-        sendImageResponse(socket, m_backgroundImage, sendBody);
-        return;
-    }
-
-    if (path == QStringLiteral("/assets/text.png")) {
-        sendImageResponse(socket, m_textImage, sendBody);
-        return;
-    }
-
-    if (path == QStringLiteral("/assets/overlay")) {
-        sendImageResponse(socket, m_overlayImage, sendBody);
-        return;
-    }
-
-    if (path == QStringLiteral("/media/main")) {
-        sendMediaResponse(socket, m_mainVideoPath, sendBody, rangeHeader);
-        return;
-    }
-
-    if (path == QStringLiteral("/media/background")) {
-        sendMediaResponse(socket, m_backgroundVideoPath, sendBody, rangeHeader);
-        return;
-    }
-
-    sendNotFound(socket);
-}
-
-void VirtualOutput::sendHttpResponse(QTcpSocket *socket, const QByteArray &statusLine,
-                                     const QByteArray &contentType, const QByteArray &body,
-                                     const QList<QByteArray> &extraHeaders, bool sendBody,
-                                     qint64 contentLength)
-{
-    if (!socket) {
-        return;
-    }
-
-    QByteArray response;
-    response += statusLine + "\r\n";
-    response += "Connection: close\r\n";
-    response += "Cache-Control: no-store, no-cache, must-revalidate\r\n";
-    response += "Pragma: no-cache\r\n";
-    if (!contentType.isEmpty()) {
-        response += "Content-Type: " + contentType + "\r\n";
-    }
-    if (contentLength < 0) {
-        contentLength = body.size();
-    }
-    response += "Content-Length: " + QByteArray::number(contentLength) + "\r\n";
-    foreach (const QByteArray &header, extraHeaders) {
-        response += header + "\r\n";
-    }
-    response += "\r\n";
-    if (sendBody) {
-        response += body;
-    }
-
-    socket->write(response);
-    resetHttpSocket(socket);
-}
-
-void VirtualOutput::sendImageResponse(QTcpSocket *socket, const AssetState &asset, bool sendBody)
-{
-    if (!asset.available) {
-        sendNotFound(socket);
-        return;
-    }
-
-    sendHttpResponse(socket, "HTTP/1.1 200 OK", asset.contentType.toUtf8(), asset.data,
-                     QList<QByteArray>(), sendBody, asset.data.size());
-}
-
-void VirtualOutput::sendMediaResponse(QTcpSocket *socket, const QString &filePath, bool sendBody,
-                                      const QByteArray &rangeHeader)
-{
-    QFile file(filePath);
-    if (filePath.isEmpty() || !file.exists() || !file.open(QIODevice::ReadOnly)) {
-        sendNotFound(socket);
-        return;
-    }
-
-    const qint64 totalSize = file.size();
-    qint64 start = 0;
-    qint64 end = totalSize > 0 ? totalSize - 1 : 0;
-    bool partial = false;
-
-    if (!rangeHeader.isEmpty() && rangeHeader.startsWith("bytes=")) {
-        const QByteArray range = rangeHeader.mid(6);
-        const QList<QByteArray> parts = range.split('-');
-        if (!parts.isEmpty()) {
-            const QByteArray startPart = parts.at(0).trimmed();
-            const QByteArray endPart = parts.size() > 1 ? parts.at(1).trimmed() : QByteArray();
-            if (!startPart.isEmpty()) {
-                start = startPart.toLongLong();
-            }
-            if (!endPart.isEmpty()) {
-                end = endPart.toLongLong();
-            }
-            if (end >= totalSize) {
-                end = totalSize - 1;
-            }
-            if (start < 0) {
-                start = 0;
-            }
-            if (start <= end && start < totalSize) {
-                partial = true;
-            }
-        }
-    }
-
-    const qint64 length = partial ? (end - start + 1) : totalSize;
-    if (partial) {
-        file.seek(start);
-    }
-    const QByteArray body = sendBody ? file.read(length) : QByteArray();
-
-    QList<QByteArray> headers;
-    headers << "Accept-Ranges: bytes";
-    if (partial) {
-        headers << QByteArray("Content-Range: bytes ") + QByteArray::number(start) + "-" + QByteArray::number(end) + "/" + QByteArray::number(totalSize);
-        sendHttpResponse(socket, "HTTP/1.1 206 Partial Content", contentTypeForFile(filePath).toUtf8(), body, headers, sendBody, length);
-    } else {
-        const QByteArray fullBody = sendBody ? file.readAll() : QByteArray();
-        sendHttpResponse(socket, "HTTP/1.1 200 OK", contentTypeForFile(filePath).toUtf8(), fullBody, headers, sendBody, totalSize);
-    }
-}
-
-void VirtualOutput::sendNotFound(QTcpSocket *socket)
-{
-    sendHttpResponse(socket, "HTTP/1.1 404 Not Found", "text/plain; charset=utf-8", "Not Found");
-}
-
-void VirtualOutput::sendMethodNotAllowed(QTcpSocket *socket)
+QByteArray VirtualOutput::assetTag(const AssetState &asset) const
 {
-    sendHttpResponse(socket, "HTTP/1.1 405 Method Not Allowed", "text/plain; charset=utf-8", "Method Not Allowed",
-                     QList<QByteArray>() << "Allow: GET, HEAD");
+    return versionTag(asset.version);
 }
 
-void VirtualOutput::sendBadRequest(QTcpSocket *socket)
+QByteArray VirtualOutput::versionTag(quint64 version) const
 {
-    sendHttpResponse(socket, "HTTP/1.1 400 Bad Request", "text/plain; charset=utf-8", "Bad Request");
+    return m_sessionTag + "-" + QByteArray::number(version);
 }
 
 void VirtualOutput::keyReleaseEvent(QKeyEvent *event)
@@ -0,0 +1,745 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include "../headers/virtualoutputserver.hpp"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMimeDatabase>
+#include <QUrlQuery>
+
+namespace
+{
+const char *kVirtualOutputPage = ":/web/virtualoutput.html";
+const char *kVirtualOutputScript = ":/web/virtualoutput.js";
+const char *kVirtualOutputStyle = ":/web/virtualoutput.css";
+
+// Longest request head accepted before the connection is dropped
+const int kMaxRequestHeaderSize = 64 * 1024;
+
+// Media is streamed in chunks, with at most this much queued per socket
+const qint64 kMediaChunkSize = 64 * 1024;
+const qint64 kMaxMediaInFlight = 512 * 1024;
+
+bool etagMatches(const QByteArray &ifNoneMatch, const QByteArray &etag)
+{
+    foreach (const QByteArray &tag, ifNoneMatch.split(',')) {
+        QByteArray candidate = tag.trimmed();
+        if (candidate.startsWith("W/")) {
+            candidate = candidate.mid(2);
+        }
+        if (candidate == "*" || candidate == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+VirtualOutputServer::VirtualOutputServer(QObject *parent)
+    : QObject(parent),
+      m_httpServer(nullptr),
+      m_webSocketServer(nullptr),
+      m_frameStream(new VirtualOutputStream(this)),
+      m_snapshot(new VirtualOutputSnapshot)
+{
+}
+
+VirtualOutputServer::~VirtualOutputServer()
+{
+    stop();
+}
+
+void VirtualOutputServer::publish(VirtualOutputSnapshotPtr snapshot)
+{
+    if (!snapshot) {
+        return;
+    }
+
+    m_snapshot = snapshot;
+    m_assetFrames.clear();
+    m_frameStream->setScene(m_snapshot->scene);
+    const QString state = QString::fromUtf8(m_snapshot->state);
+    foreach (QWebSocket *client, m_clients) {
+        if (client && client->isValid()) {
+            sendInlineAssets(client);
+            client->sendTextMessage(state);
+        }
+    }
+}
+
+void VirtualOutputServer::sendInlineAssets(QWebSocket *socket)
+{
+    // Changed assets go ahead of the state, so the page has every image the
+    // state names by the time it applies it. Unchanged ones are only named.
+    if (!m_inlineClients.contains(socket)) {
+        return;
+    }
+    sendInlineAsset(socket, "background", m_snapshot->background);
+    sendInlineAsset(socket, "overlay", m_snapshot->overlay);
+
+    // A page holding the slide the text delta is based on only needs the tiles
+    QHash<QByteArray, QByteArray> &tags = m_inlineClients[socket];
+    const VirtualOutputAsset &delta = m_snapshot->textDelta;
+    if (delta.available && tags.value("text") == delta.baseTag) {
+        socket->sendBinaryMessage(assetFrame("textdelta", delta));
+        tags.insert("text", delta.tag);
+    } else {
+        sendInlineAsset(socket, "text", m_snapshot->text);
+    }
+}
+
+void VirtualOutputServer::sendInlineAsset(QWebSocket *socket, const QByteArray &name, const VirtualOutputAsset &asset)
+{
+    QHash<QByteArray, QByteArray> &tags = m_inlineClients[socket];
+    if (!asset.available || tags.value(name) == asset.tag) {
+        return;
+    }
+    socket->sendBinaryMessage(assetFrame(name, asset));
+    tags.insert(name, asset.tag);
+}
+
+QByteArray VirtualOutputServer::assetFrame(const QByteArray &name, const VirtualOutputAsset &asset)
+{
+    // Frames are a 16 bit big endian header length, a JSON header and the
+    // encoded image. Built once per snapshot and shared by all clients.
+    if (m_assetFrames.contains(name)) {
+        return m_assetFrames.value(name);
+    }
+
+    QJsonObject header;
+    header.insert(QStringLiteral("asset"), QString::fromLatin1(name));
+    header.insert(QStringLiteral("version"), QString::fromLatin1(asset.tag));
+    header.insert(QStringLiteral("contentType"), QString::fromLatin1(asset.contentType));
+    const QByteArray json = QJsonDocument(header).toJson(QJsonDocument::Compact);
+
+    QByteArray frame;
+    frame.reserve(2 + json.size() + asset.data.size());
+    frame.append(char((json.size() >> 8) & 0xff));
+    frame.append(char(json.size() & 0xff));
+    frame += json;
+    frame += asset.data;
+    m_assetFrames.insert(name, frame);
+    return frame;
+}
+
+bool VirtualOutputServer::start(int httpPort, int websocketPort)
+{
+    stop();
+
+    m_httpServer = new QTcpServer(this);
+    connect(m_httpServer, SIGNAL(newConnection()), this, SLOT(onNewHttpConnection()));
+
+    if (!m_httpServer->listen(QHostAddress::LocalHost, quint16(httpPort))) {
+        qWarning() << "Failed to start virtual output HTTP server:" << m_httpServer->errorString();
+        delete m_httpServer;
+        m_httpServer = nullptr;
+        return false;
+    }
+
+    m_webSocketServer = new QWebSocketServer(QStringLiteral("softProjector Virtual Output"),
+                                             QWebSocketServer::NonSecureMode, this);
+    connect(m_webSocketServer, SIGNAL(newConnection()), this, SLOT(onNewWebSocketConnection()));
+
+    if (!m_webSocketServer->listen(QHostAddress::LocalHost, quint16(websocketPort))) {
+        qWarning() << "Failed to start virtual output WebSocket server:" << m_webSocketServer->errorString();
+        m_httpServer->close();
+        delete m_httpServer;
+        m_httpServer = nullptr;
+        delete m_webSocketServer;
+        m_webSocketServer = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void VirtualOutputServer::stop()
+{
+    foreach (QWebSocket *client, m_clients) {
+        if (client) {
+            client->close();
+            client->deleteLater();
+        }
+    }
+    m_clients.clear();
+    m_inlineClients.clear();
+
+    foreach (QTcpSocket *socket, m_mediaStreams.keys()) {
+        finishMediaStream(socket);
+    }
+    m_frameStream->clear();
+
+    foreach (QTcpSocket *socket, m_httpSockets) {
+        if (socket) {
+            socket->disconnect(this);
+            socket->close();
+            socket->deleteLater();
+        }
+    }
+    m_httpSockets.clear();
+
+    if (m_httpServer) {
+        m_httpServer->close();
+        m_httpServer->deleteLater();
+        m_httpServer = nullptr;
+    }
+
+    if (m_webSocketServer) {
+        m_webSocketServer->close();
+        m_webSocketServer->deleteLater();
+        m_webSocketServer = nullptr;
+    }
+}
+
+quint16 VirtualOutputServer::httpPort() const
+{
+    return m_httpServer ? m_httpServer->serverPort() : 0;
+}
+
+void VirtualOutputServer::onNewHttpConnection()
+{
+    if (!m_httpServer) {
+        return;
+    }
+
+    while (m_httpServer->hasPendingConnections()) {
+        QTcpSocket *socket = m_httpServer->nextPendingConnection();
+        m_httpSockets.insert(socket);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onSocketReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onSocketDisconnected()));
+        connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onSocketBytesWritten()));
+    }
+}
+
+void VirtualOutputServer::onSocketReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+
+    socket->setProperty("requestBuffer", socket->property("requestBuffer").toByteArray() + socket->readAll());
+    processHttpRequests(socket);
+}
+
+void VirtualOutputServer::processHttpRequests(QTcpSocket *socket)
+{
+    // Connections are persistent and clients may pipeline requests, answer
+    // every complete request head in the order it arrived. A media stream
+    // owns the socket until its last byte is queued, a frame stream for good.
+    while (!m_mediaStreams.contains(socket) && !m_frameStream->hasClient(socket)) {
+        const QByteArray buffer = socket->property("requestBuffer").toByteArray();
+        const int headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            if (buffer.size() > kMaxRequestHeaderSize) {
+                socket->setProperty("requestBuffer", QByteArray());
+                sendBadRequest(socket);
+            }
+            return;
+        }
+
+        socket->setProperty("requestBuffer", buffer.mid(headerEnd + 4));
+        handleHttpRequest(socket, buffer.left(headerEnd + 4));
+        if (socket->property("closeAfterResponse").toBool()) {
+            socket->setProperty("requestBuffer", QByteArray());
+            return;
+        }
+    }
+}
+
+void VirtualOutputServer::onSocketDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+    finishMediaStream(socket);
+    m_frameStream->removeClient(socket);
+    m_httpSockets.remove(socket);
+    socket->deleteLater();
+}
+
+void VirtualOutputServer::onSocketBytesWritten()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket) {
+        pumpMediaStream(socket);
+    }
+}
+
+void VirtualOutputServer::onNewWebSocketConnection()
+{
+    if (!m_webSocketServer) {
+        return;
+    }
+
+    QWebSocket *socket = m_webSocketServer->nextPendingConnection();
+    if (!socket) {
+        return;
+    }
+
+    connect(socket, SIGNAL(disconnected()), this, SLOT(onWebSocketDisconnected()));
+    m_clients.insert(socket);
+    if (QUrlQuery(socket->requestUrl()).queryItemValue(QStringLiteral("assets")) == QStringLiteral("inline")) {
+        m_inlineClients.insert(socket, QHash<QByteArray, QByteArray>());
+        sendInlineAssets(socket);
+    }
+    sendState(socket);
+}
+
+void VirtualOutputServer::onWebSocketDisconnected()
+{
+    QWebSocket *socket = qobject_cast<QWebSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+    m_clients.remove(socket);
+    m_inlineClients.remove(socket);
+    socket->deleteLater();
+}
+
+void VirtualOutputServer::resetHttpSocket(QTcpSocket *socket)
+{
+    if (!socket) {
+        return;
+    }
+    socket->disconnectFromHost();
+}
+
+void VirtualOutputServer::handleHttpRequest(QTcpSocket *socket, const QByteArray &requestData)
+{
+    const QList<QByteArray> sections = requestData.split('\n');
+    if (sections.isEmpty()) {
+        sendBadRequest(socket);
+        return;
+    }
+
+    const QByteArray requestLine = sections.first().trimmed();
+    const QList<QByteArray> requestParts = requestLine.split(' ');
+    if (requestParts.size() < 2) {
+        sendBadRequest(socket);
+        return;
+    }
+
+    QByteArray rangeHeader;
+    QByteArray ifNoneMatch;
+    QByteArray connectionHeader;
+    for (int i = 1; i < sections.count(); ++i) {
+        const QByteArray line = sections.at(i).trimmed();
+        const int colon = line.indexOf(':');
+        if (colon <= 0) {
+            continue;
+        }
+        const QByteArray name = line.left(colon).trimmed().toLower();
+        const QByteArray value = line.mid(colon + 1).trimmed();
+        if (name == "range") {
+            rangeHeader = value;
+        } else if (name == "if-none-match") {
+            ifNoneMatch = value;
+        } else if (name == "connection") {
+            connectionHeader = value.toLower();
+        }
+    }
+
+    // HTTP/1.1 connections stay open unless the client asks to close them
+    const bool http11 = requestParts.size() > 2 && requestParts.at(2) == "HTTP/1.1";
+    const bool keepAlive = http11 ? !connectionHeader.contains("close") : connectionHeader.contains("keep-alive");
+    socket->setProperty("closeAfterResponse", !keepAlive);
+
+    const QByteArray method = requestParts.at(0);
+    const bool sendBody = (method != "HEAD");
+    if (method != "GET" && method != "HEAD") {
+        sendMethodNotAllowed(socket);
+        return;
+    }
+
+    // Keep the snapshot of this request alive even if a newer one arrives
+    const VirtualOutputSnapshotPtr snapshot = m_snapshot;
+    const QUrl url = QUrl::fromEncoded(requestParts.at(1));
+    const QString path = url.path().isEmpty() ? QStringLiteral("/") : url.path();
+
+    if (path == QStringLiteral("/") || path == QStringLiteral("/index.html")) {
+        sendStaticResponse(socket, QString::fromLatin1(kVirtualOutputPage), "text/html; charset=utf-8",
+                           sendBody, ifNoneMatch);
+        return;
+    }
+
+    if (path == QStringLiteral("/virtualoutput.js")) {
+        sendStaticResponse(socket, QString::fromLatin1(kVirtualOutputScript), "application/javascript; charset=utf-8",
+                           sendBody, ifNoneMatch);
+        return;
+    }
+
+    if (path == QStringLiteral("/virtualoutput.css")) {
+        sendStaticResponse(socket, QString::fromLatin1(kVirtualOutputStyle), "text/css; charset=utf-8",
+                           sendBody, ifNoneMatch);
+        return;
+    }
+
+    // The .png names are kept for pages loaded before assets could be JPEG or WebP
+    if (path == QStringLiteral("/assets/background") || path == QStringLiteral("/assets/background.png")) {
+        sendImageResponse(socket, snapshot->background, url, sendBody, ifNoneMatch);
+        return;
+    }
+
+    if (path == QStringLiteral("/assets/text") || path == QStringLiteral("/assets/text.png")) {
+        sendImageResponse(socket, snapshot->text, url, sendBody, ifNoneMatch);
+        return;
+    }
+
+    if (path == QStringLiteral("/assets/textdelta")) {
+        // An atlas only fits the tile list of its own state, a page asking
+        // for an older one has to skip it rather than paste the current one
+        if (QUrlQuery(url).queryItemValue(QStringLiteral("v")) != QString::fromLatin1(snapshot->textDelta.tag)) {
+            sendNotFound(socket);
+            return;
+        }
+        sendImageResponse(socket, snapshot->textDelta, url, sendBody, ifNoneMatch);
+        return;
+    }
+
+    if (path == QStringLiteral("/assets/overlay")) {
+        sendImageResponse(socket, snapshot->overlay, url, sendBody, ifNoneMatch);
+        return;
+    }
+
+    if (path == QStringLiteral("/media/main")) {
+        sendMediaResponse(socket, snapshot->mainVideoPath, sendBody, rangeHeader);
+        return;
+    }
+
+    if (path == QStringLiteral("/media/background")) {
+        sendMediaResponse(socket, snapshot->backgroundVideoPath, sendBody, rangeHeader);
+        return;
+    }
+
+    if (path == QStringLiteral("/stream.mjpeg")) {
+        startFrameStream(socket, sendBody);
+        return;
+    }
+
+    sendNotFound(socket);
+}
+
+void VirtualOutputServer::sendHttpResponse(QTcpSocket *socket, const QByteArray &statusLine,
+                                     const QByteArray &contentType, const QByteArray &body,
+                                     const QList<QByteArray> &extraHeaders, bool sendBody,
+                                     qint64 contentLength)
+{
+    if (!socket) {
+        return;
+    }
+
+    if (contentLength < 0) {
+        contentLength = body.size();
+    }
+    writeHttpHead(socket, statusLine, contentType, extraHeaders, contentLength);
+    if (sendBody) {
+        socket->write(body);
+    }
+    finishHttpResponse(socket);
+}
+
+void VirtualOutputServer::writeHttpHead(QTcpSocket *socket, const QByteArray &statusLine, const QByteArray &contentType,
+                                  const QList<QByteArray> &extraHeaders, qint64 contentLength)
+{
+    const bool closeConnection = socket->property("closeAfterResponse").toBool();
+    bool cacheControl = false;
+    foreach (const QByteArray &header, extraHeaders) {
+        if (header.startsWith("Cache-Control:")) {
+            cacheControl = true;
+        }
+    }
+
+    QByteArray response;
+    response += statusLine + "\r\n";
+    response += closeConnection ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+    if (!cacheControl) {
+        response += "Cache-Control: no-store, no-cache, must-revalidate\r\n";
+        response += "Pragma: no-cache\r\n";
+    }
+    if (!contentType.isEmpty()) {
+        response += "Content-Type: " + contentType + "\r\n";
+    }
+    // 304 responses describe the cached body, a zero length would contradict it.
+    // Endless bodies are delimited by closing the connection.
+    if (!statusLine.contains(" 304 ") && contentLength >= 0) {
+        response += "Content-Length: " + QByteArray::number(contentLength) + "\r\n";
+    }
+    foreach (const QByteArray &header, extraHeaders) {
+        response += header + "\r\n";
+    }
+    response += "\r\n";
+    socket->write(response);
+}
+
+void VirtualOutputServer::finishHttpResponse(QTcpSocket *socket)
+{
+    if (socket->property("closeAfterResponse").toBool()) {
+        resetHttpSocket(socket);
+    }
+}
+
+void VirtualOutputServer::sendStaticResponse(QTcpSocket *socket, const QString &resource, const QByteArray &contentType,
+                                       bool sendBody, const QByteArray &ifNoneMatch)
+{
+    // Resources never change while running, read and hash each of them once
+    if (!m_staticFiles.contains(resource)) {
+        QFile file(resource);
+        if (!file.open(QIODevice::ReadOnly)) {
+            sendNotFound(socket);
+            return;
+        }
+        StaticFile staticFile;
+        staticFile.body = file.readAll();
+        staticFile.contentType = contentType;
+        staticFile.etag = "\"" + QCryptographicHash::hash(staticFile.body, QCryptographicHash::Md5).toHex().left(16) + "\"";
+        m_staticFiles.insert(resource, staticFile);
+    }
+
+    const StaticFile &staticFile = m_staticFiles[resource];
+    QList<QByteArray> headers;
+    headers << "ETag: " + staticFile.etag;
+    headers << "Cache-Control: no-cache";
+    if (etagMatches(ifNoneMatch, staticFile.etag)) {
+        sendHttpResponse(socket, "HTTP/1.1 304 Not Modified", QByteArray(), QByteArray(), headers, false);
+        return;
+    }
+    sendHttpResponse(socket, "HTTP/1.1 200 OK", staticFile.contentType, staticFile.body,
+                     headers, sendBody, staticFile.body.size());
+}
+
+void VirtualOutputServer::sendImageResponse(QTcpSocket *socket, const VirtualOutputAsset &asset, const QUrl &url,
+                                      bool sendBody, const QByteArray &ifNoneMatch)
+{
+    if (!asset.available) {
+        sendNotFound(socket);
+        return;
+    }
+
+    // A versioned URL always names the same bytes and may be cached forever.
+    // Stale or missing versions get the current asset, which must be revalidated.
+    const QByteArray etag = "\"" + asset.tag + "\"";
+    QList<QByteArray> headers;
+    headers << "ETag: " + etag;
+    if (QUrlQuery(url).queryItemValue(QStringLiteral("v")) == QString::fromLatin1(asset.tag)) {
+        headers << "Cache-Control: public, max-age=31536000, immutable";
+    } else {
+        headers << "Cache-Control: no-cache";
+    }
+
+    if (etagMatches(ifNoneMatch, etag)) {
+        sendHttpResponse(socket, "HTTP/1.1 304 Not Modified", QByteArray(), QByteArray(), headers, false);
+        return;
+    }
+    sendHttpResponse(socket, "HTTP/1.1 200 OK", asset.contentType, asset.data,
+                     headers, sendBody, asset.data.size());
+}
+
+void VirtualOutputServer::sendMediaResponse(QTcpSocket *socket, const QString &filePath, bool sendBody,
+                                      const QByteArray &rangeHeader)
+{
+    QFile file(filePath);
+    if (filePath.isEmpty() || !file.exists() || !file.open(QIODevice::ReadOnly)) {
+        sendNotFound(socket);
+        return;
+    }
+
+    const qint64 totalSize = file.size();
+    qint64 start = 0;
+    qint64 end = totalSize > 0 ? totalSize - 1 : 0;
+    bool partial = false;
+
+    if (!rangeHeader.isEmpty() && rangeHeader.startsWith("bytes=")) {
+        const QByteArray range = rangeHeader.mid(6);
+        const QList<QByteArray> parts = range.split('-');
+        if (!parts.isEmpty()) {
+            const QByteArray startPart = parts.at(0).trimmed();
+            const QByteArray endPart = parts.size() > 1 ? parts.at(1).trimmed() : QByteArray();
+            if (!startPart.isEmpty()) {
+                start = startPart.toLongLong();
+                if (!endPart.isEmpty()) {
+                    end = endPart.toLongLong();
+                }
+            } else if (!endPart.isEmpty()) {
+                // "bytes=-N" asks for the last N bytes
+                start = totalSize - endPart.toLongLong();
+            }
+            if (end >= totalSize) {
+                end = totalSize - 1;
+            }
+            if (start < 0) {
+                start = 0;
+            }
+            if (start <= end && start < totalSize) {
+                partial = true;
+            }
+        }
+    }
+
+    if (!partial) {
+        start = 0;
+    }
+    const qint64 length = partial ? (end - start + 1) : totalSize;
+    file.close();
+
+    QList<QByteArray> headers;
+    headers << "Accept-Ranges: bytes";
+    if (partial) {
+        headers << QByteArray("Content-Range: bytes ") + QByteArray::number(start) + "-" + QByteArray::number(end) + "/" + QByteArray::number(totalSize);
+        writeHttpHead(socket, "HTTP/1.1 206 Partial Content", contentTypeForFile(filePath).toUtf8(), headers, length);
+    } else {
+        writeHttpHead(socket, "HTTP/1.1 200 OK", contentTypeForFile(filePath).toUtf8(), headers, totalSize);
+    }
+
+    if (!sendBody || length <= 0) {
+        finishHttpResponse(socket);
+        return;
+    }
+    startMediaStream(socket, filePath, start, length);
+}
+
+void VirtualOutputServer::startMediaStream(QTcpSocket *socket, const QString &filePath, qint64 start, qint64 length)
+{
+    MediaStream stream;
+    stream.file = new QFile(filePath);
+    if (!stream.file->open(QIODevice::ReadOnly)) {
+        // The head is already out, the client can only see a short body
+        delete stream.file;
+        socket->setProperty("closeAfterResponse", true);
+        resetHttpSocket(socket);
+        return;
+    }
+
+    // A mapping lets every client read from the page cache without a buffer
+    // of its own. Files that can't be mapped are read one chunk at a time.
+    stream.map = stream.file->map(start, length);
+    if (!stream.map) {
+        stream.file->seek(start);
+    }
+    stream.length = length;
+    m_mediaStreams.insert(socket, stream);
+    pumpMediaStream(socket);
+}
+
+void VirtualOutputServer::pumpMediaStream(QTcpSocket *socket)
+{
+    QHash<QTcpSocket*, MediaStream>::iterator it = m_mediaStreams.find(socket);
+    if (it == m_mediaStreams.end()) {
+        return;
+    }
+
+    MediaStream &stream = it.value();
+    while (stream.position < stream.length && socket->bytesToWrite() < kMaxMediaInFlight) {
+        const qint64 chunk = qMin(kMediaChunkSize, stream.length - stream.position);
+        qint64 written = -1;
+        if (stream.map) {
+            written = socket->write(reinterpret_cast<const char*>(stream.map + stream.position), chunk);
+        } else {
+            const QByteArray data = stream.file->read(chunk);
+            if (!data.isEmpty()) {
+                written = socket->write(data);
+            }
+        }
+
+        if (written <= 0) {
+            finishMediaStream(socket);
+            socket->setProperty("closeAfterResponse", true);
+            resetHttpSocket(socket);
+            return;
+        }
+        stream.position += written;
+    }
+
+    if (stream.position < stream.length) {
+        return;
+    }
+
+    finishMediaStream(socket);
+    finishHttpResponse(socket);
+    if (!socket->property("closeAfterResponse").toBool()) {
+        processHttpRequests(socket);
+    }
+}
+
+void VirtualOutputServer::finishMediaStream(QTcpSocket *socket)
+{
+    if (!m_mediaStreams.contains(socket)) {
+        return;
+    }
+
+    MediaStream stream = m_mediaStreams.take(socket);
+    if (stream.map) {
+        stream.file->unmap(stream.map);
+    }
+    delete stream.file;
+}
+
+void VirtualOutputServer::startFrameStream(QTcpSocket *socket, bool sendBody)
+{
+    // The stream has no length, it ends when the consumer disconnects
+    socket->setProperty("closeAfterResponse", true);
+    writeHttpHead(socket, "HTTP/1.1 200 OK",
+                  "multipart/x-mixed-replace; boundary=" + VirtualOutputStream::boundary(),
+                  QList<QByteArray>(), -1);
+    if (!sendBody) {
+        finishHttpResponse(socket);
+        return;
+    }
+    socket->setProperty("requestBuffer", QByteArray());
+    m_frameStream->addClient(socket);
+}
+
+void VirtualOutputServer::sendNotFound(QTcpSocket *socket)
+{
+    sendHttpResponse(socket, "HTTP/1.1 404 Not Found", "text/plain; charset=utf-8", "Not Found");
+}
+
+void VirtualOutputServer::sendMethodNotAllowed(QTcpSocket *socket)
+{
+    // Any request body is left unread, so the connection can't be reused
+    socket->setProperty("closeAfterResponse", true);
+    sendHttpResponse(socket, "HTTP/1.1 405 Method Not Allowed", "text/plain; charset=utf-8", "Method Not Allowed",
+                     QList<QByteArray>() << "Allow: GET, HEAD");
+}
+
+void VirtualOutputServer::sendBadRequest(QTcpSocket *socket)
+{
+    socket->setProperty("closeAfterResponse", true);
+    sendHttpResponse(socket, "HTTP/1.1 400 Bad Request", "text/plain; charset=utf-8", "Bad Request");
+}
+
+QString VirtualOutputServer::contentTypeForFile(const QString &path)
+{
+    QMimeDatabase db;
+    const QMimeType mime = db.mimeTypeForFile(path);
+    return mime.isValid() ? mime.name() : QString();
+}
+
+void VirtualOutputServer::sendState(QWebSocket *socket)
+{
+    if (!socket || !socket->isValid() || m_snapshot->state.isEmpty()) {
+        return;
+    }
+    socket->sendTextMessage(QString::fromUtf8(m_snapshot->state));
+}
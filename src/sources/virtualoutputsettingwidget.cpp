@@ -76,6 +76,8 @@ void VirtualOutputSettingWidget::loadSettings()
 
     ui->spinBoxWidth->setValue(m_settings.width);
     ui->spinBoxHeight->setValue(m_settings.height);
+    ui->comboBoxImageFormat->setCurrentIndex(m_settings.backgroundCodec);
+    ui->spinBoxStreamFrameRate->setValue(m_settings.streamFrameRate);
 
     if (m_settings.mirrorDisplay1) {
         ui->radioButtonMirrorDisplay1->setChecked(true);
@@ -124,6 +126,8 @@ void VirtualOutputSettingWidget::saveSettings()
         m_settings.height = ui->spinBoxHeight->value();
         break;
     }
+    m_settings.backgroundCodec = ui->comboBoxImageFormat->currentIndex();
+    m_settings.streamFrameRate = ui->spinBoxStreamFrameRate->value();
 
     m_settings.mirrorDisplay1 = ui->radioButtonMirrorDisplay1->isChecked();
     if (!m_settings.mirrorDisplay1) {
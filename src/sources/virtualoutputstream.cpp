@@ -0,0 +1,268 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include "../headers/virtualoutputstream.hpp"
+
+#include <QBuffer>
+#include <QImageWriter>
+#include <QPainter>
+#include <QtConcurrent>
+
+namespace
+{
+const int kStreamJpegQuality = 80;
+
+// Matches the 180 ms opacity transition of the browser page
+const int kFadeDuration = 180;
+
+// Unchanged frames are sent again this often, so consumers that dropped
+// one or joined late never wait long for a full picture
+const int kKeyframeInterval = 1000;
+
+// Consumers with this much still queued skip frames instead of buffering them
+const qint64 kMaxFrameBacklog = 2 * 1024 * 1024;
+
+const char *kStreamBoundary = "softprojectorframe";
+}
+
+bool VirtualOutputScene::sameFrame(const VirtualOutputScene &other) const
+{
+    return background.cacheKey() == other.background.cacheKey()
+            && fillMode == other.fillMode
+            && color == other.color
+            && text.cacheKey() == other.text.cacheKey()
+            && text.offset() == other.text.offset()
+            && overlay.cacheKey() == other.overlay.cacheKey()
+            && size == other.size;
+}
+
+VirtualOutputStream::VirtualOutputStream(QObject *parent)
+    : QObject(parent),
+      m_dirty(false),
+      m_timer(this),
+      m_watcher(this),
+      m_rendering(false)
+{
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(onTick()));
+    connect(&m_watcher, SIGNAL(finished()), this, SLOT(onFrameRendered()));
+}
+
+VirtualOutputStream::~VirtualOutputStream()
+{
+    m_watcher.waitForFinished();
+}
+
+QByteArray VirtualOutputStream::boundary()
+{
+    return QByteArray(kStreamBoundary);
+}
+
+void VirtualOutputStream::setScene(const VirtualOutputScene &scene)
+{
+    const bool changed = !scene.sameFrame(m_scene);
+    const bool fade = scene.fade && !m_shown.isNull() && m_shown.size() == scene.size;
+    m_scene = scene;
+    updateTimer();
+    if (!changed) {
+        return;
+    }
+
+    // A fade starts from whatever is on screen, even halfway through another one
+    m_from = fade ? m_shown : QImage();
+    m_fadeTimer.start();
+    m_dirty = true;
+    renderNext();
+}
+
+void VirtualOutputStream::addClient(QTcpSocket *socket)
+{
+    m_clients.insert(socket);
+    if (!m_dirty && !m_lastFrame.isEmpty()) {
+        socket->write(m_lastFrame);
+    } else {
+        m_dirty = true;
+        renderNext();
+    }
+    updateTimer();
+}
+
+void VirtualOutputStream::removeClient(QTcpSocket *socket)
+{
+    m_clients.remove(socket);
+    updateTimer();
+}
+
+void VirtualOutputStream::clear()
+{
+    m_clients.clear();
+    updateTimer();
+}
+
+void VirtualOutputStream::updateTimer()
+{
+    if (m_clients.isEmpty()) {
+        m_timer.stop();
+        return;
+    }
+    const int interval = 1000 / qBound(1, m_scene.frameRate, 60);
+    if (!m_timer.isActive() || m_timer.interval() != interval) {
+        m_timer.start(interval);
+    }
+}
+
+void VirtualOutputStream::onTick()
+{
+    if (m_dirty) {
+        renderNext();
+    } else if (!m_lastFrame.isEmpty() && m_sinceLastFrame.elapsed() >= kKeyframeInterval) {
+        sendFrame(m_lastFrame);
+    }
+}
+
+void VirtualOutputStream::renderNext()
+{
+    // One frame is rendered at a time, a scene that changes meanwhile is
+    // picked up by the next tick
+    if (m_rendering || m_clients.isEmpty() || m_scene.size.isEmpty()) {
+        return;
+    }
+
+    qreal progress = 1;
+    if (!m_from.isNull()) {
+        progress = qMin<qreal>(1, qreal(m_fadeTimer.elapsed()) / kFadeDuration);
+    }
+    m_dirty = progress < 1;
+
+    m_renderingBackgroundKey = backgroundKey(m_scene);
+    const VirtualOutputScene scene = m_scene;
+    const QImage background = (m_renderingBackgroundKey == m_scaledBackgroundKey) ? m_scaledBackground : QImage();
+    const QImage from = m_from;
+    if (progress >= 1) {
+        m_from = QImage();
+    }
+    m_rendering = true;
+    m_watcher.setFuture(QtConcurrent::run(QThreadPool::globalInstance(), [scene, background, from, progress]() {
+        return renderFrame(scene, background, from, progress);
+    }));
+}
+
+void VirtualOutputStream::onFrameRendered()
+{
+    m_rendering = false;
+    const Frame frame = m_watcher.result();
+    m_scaledBackground = frame.background;
+    m_scaledBackgroundKey = m_renderingBackgroundKey;
+    m_shown = frame.image;
+    if (frame.jpeg.isEmpty()) {
+        return;
+    }
+
+    QByteArray part;
+    part.reserve(frame.jpeg.size() + 128);
+    part += "--" + boundary() + "\r\n";
+    part += "Content-Type: image/jpeg\r\n";
+    part += "Content-Length: " + QByteArray::number(frame.jpeg.size()) + "\r\n\r\n";
+    part += frame.jpeg;
+    part += "\r\n";
+    m_lastFrame = part;
+    sendFrame(m_lastFrame);
+}
+
+void VirtualOutputStream::sendFrame(const QByteArray &part)
+{
+    m_sinceLastFrame.start();
+    foreach (QTcpSocket *socket, m_clients) {
+        if (socket->bytesToWrite() < kMaxFrameBacklog) {
+            socket->write(part);
+        }
+    }
+}
+
+QString VirtualOutputStream::backgroundKey(const VirtualOutputScene &scene)
+{
+    return QString("%1:%2:%3x%4").arg(scene.background.cacheKey()).arg(scene.fillMode)
+            .arg(scene.size.width()).arg(scene.size.height());
+}
+
+QImage VirtualOutputStream::scaleBackground(const VirtualOutputScene &scene)
+{
+    switch (scene.fillMode) {
+    case 0:
+        return scene.background.scaled(scene.size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    case 2:
+        return scene.background.scaled(scene.size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    case 3:
+        // Slides that must not be expanded are shown as they are, like the
+        // projector does
+        return scene.background;
+    case 1:
+    default:
+        return scene.background.scaled(scene.size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+}
+
+VirtualOutputStream::Frame VirtualOutputStream::renderFrame(const VirtualOutputScene &scene, const QImage &background,
+                                                            const QImage &from, qreal progress)
+{
+    Frame frame;
+    frame.background = background;
+    if (frame.background.isNull() && !scene.background.isNull()) {
+        frame.background = scaleBackground(scene);
+    }
+
+    const QRect bounds(QPoint(0, 0), scene.size);
+    QImage target(scene.size, QImage::Format_RGB32);
+    target.fill(Qt::black);
+    {
+        QPainter painter(&target);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.fillRect(bounds, scene.color);
+        if (!frame.background.isNull()) {
+            // Centred, so expanded backgrounds are cropped evenly on both sides
+            QRect rect(QPoint(0, 0), frame.background.size());
+            rect.moveCenter(bounds.center());
+            painter.drawImage(rect, frame.background);
+        }
+        if (!scene.text.isNull()) {
+            painter.drawImage(scene.text.offset(), scene.text);
+        }
+        if (!scene.overlay.isNull()) {
+            QRect rect(QPoint(0, 0), scene.overlay.size().scaled(scene.size, Qt::KeepAspectRatio));
+            rect.moveCenter(bounds.center());
+            painter.drawImage(rect, scene.overlay);
+        }
+    }
+
+    frame.image = target;
+    if (!from.isNull() && progress < 1) {
+        frame.image = from.convertToFormat(QImage::Format_RGB32);
+        QPainter painter(&frame.image);
+        painter.setOpacity(progress);
+        painter.drawImage(0, 0, target);
+    }
+
+    QBuffer buffer(&frame.jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "jpeg");
+    writer.setQuality(kStreamJpegQuality);
+    if (!writer.write(frame.image)) {
+        frame.jpeg.clear();
+    }
+    return frame;
+}
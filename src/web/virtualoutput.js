@@ -9,6 +9,67 @@
 
   let backgroundIndex = 0;
   let textIndex = 0;
+  let textVersion = null;
+  let textSequence = 0;
+
+  // With ?assets=inline the server pushes changed images over the WebSocket
+  // ahead of each state instead of the page fetching them over HTTP
+  const params = new URLSearchParams(window.location.search);
+  const inlineMode = params.get('assets') === 'inline';
+  const inlineImages = {};
+
+  // With ?debug=latency the page measures the time from the first message of
+  // an update until its new image is shown, logs it and keeps the totals in
+  // window.virtualOutputLatency
+  const latency = params.getAll('debug').includes('latency')
+    ? { mode: inlineMode ? 'inline' : 'http', count: 0, total: 0, last: 0 }
+    : null;
+  let updateStarted = 0;
+  if (latency) {
+    window.virtualOutputLatency = latency;
+  }
+
+  function recordLatency(started) {
+    if (!latency || !started) {
+      return;
+    }
+    latency.last = performance.now() - started;
+    latency.count += 1;
+    latency.total += latency.last;
+    console.debug(`virtual output ${latency.mode} latency ${latency.last.toFixed(1)} ms, average ${(latency.total / latency.count).toFixed(1)} ms`);
+  }
+
+  function measureLatency(element, started) {
+    if (!latency) {
+      return;
+    }
+    element.addEventListener('load', () => recordLatency(started), { once: true });
+  }
+
+  function loadImage(url) {
+    return new Promise((resolve, reject) => {
+      const image = new Image();
+      image.onload = () => resolve(image);
+      image.onerror = reject;
+      image.src = url;
+    });
+  }
+
+  function receiveAsset(buffer) {
+    const headerLength = new DataView(buffer).getUint16(0);
+    const header = JSON.parse(new TextDecoder().decode(new Uint8Array(buffer, 2, headerLength)));
+    const blob = new Blob([new Uint8Array(buffer, 2 + headerLength)], { type: header.contentType });
+    const previous = inlineImages[header.asset];
+    if (previous) {
+      URL.revokeObjectURL(previous.url);
+    }
+    inlineImages[header.asset] = { version: header.version, url: URL.createObjectURL(blob) };
+  }
+
+  function assetUrl(name, image) {
+    const inline = inlineImages[name];
+    return inline && inline.version === image.version ? inline.url : image.url;
+  }
 
   function applyFade(element, fade) {
     element.classList.toggle('fade', fade);
@@ -30,6 +91,7 @@
     }
 
     if (active.dataset.src !== url) {
+      measureLatency(active, updateStarted);
       active.dataset.src = url;
       active.src = url;
     }
@@ -39,6 +101,83 @@
     indexRef.value = nextIndex;
   }
 
+  function placeLayer(element, image, stageWidth, stageHeight) {
+    // Text images only cover the text; position them on the stage in percent
+    // so they scale with it
+    if (!image.width || !image.height || !stageWidth || !stageHeight) {
+      element.style.left = '0';
+      element.style.top = '0';
+      element.style.width = '100%';
+      element.style.height = '100%';
+      return;
+    }
+    element.style.left = `${(image.x / stageWidth) * 100}%`;
+    element.style.top = `${(image.y / stageHeight) * 100}%`;
+    element.style.width = `${(image.width / stageWidth) * 100}%`;
+    element.style.height = `${(image.height / stageHeight) * 100}%`;
+    element.style.objectFit = 'fill';
+  }
+
+  async function showText(state, fade, started) {
+    const text = state.textImage;
+    const sequence = ++textSequence;
+    const current = textLayers[textIndex];
+    const next = textLayers[textIndex === 0 ? 1 : 0];
+
+    applyFade(current, fade);
+    applyFade(next, fade);
+
+    if (!text.enabled) {
+      current.classList.remove('active');
+      next.classList.remove('active');
+      textVersion = null;
+      return;
+    }
+
+    if (text.version === textVersion) {
+      placeLayer(current, text, state.width, state.height);
+      return;
+    }
+
+    // A delta only applies on top of the slide it was made against
+    const delta = text.delta && text.delta.base === textVersion ? text.delta : null;
+    let image;
+    try {
+      image = await loadImage(delta
+        ? assetUrl('textdelta', { version: text.version, url: delta.url })
+        : assetUrl('text', text));
+    } catch (err) {
+      return;
+    }
+    if (sequence !== textSequence) {
+      return;
+    }
+
+    const context = next.getContext('2d');
+    if (delta) {
+      next.width = current.width;
+      next.height = current.height;
+      context.drawImage(current, 0, 0);
+      delta.tiles.forEach(([x, y, w, h], i) => {
+        const atlasX = (i % delta.columns) * delta.tileSize;
+        const atlasY = Math.floor(i / delta.columns) * delta.tileSize;
+        context.clearRect(x, y, w, h);
+        context.drawImage(image, atlasX, atlasY, w, h, x, y, w, h);
+      });
+    } else {
+      next.width = image.naturalWidth;
+      next.height = image.naturalHeight;
+      context.drawImage(image, 0, 0);
+    }
+
+    placeLayer(next, text, state.width, state.height);
+    next.classList.add('active');
+    current.classList.remove('active');
+    textIndex = textIndex === 0 ? 1 : 0;
+    textVersion = text.version;
+    recordLatency(started);
+  }
+
   function setVideoFillMode(video, fillMode, isMain) {
     if (isMain) {
       video.style.objectFit = 'contain';
@@ -108,14 +247,17 @@
     stage.style.width = `${state.width}px`;
     stage.style.height = `${state.height}px`;
 
+    stage.style.backgroundColor = state.backgroundColor || '';
+
     const fade = state.transition === 'fade';
-    swapLayer(backgroundLayers, { get value() { return backgroundIndex; }, set value(v) { backgroundIndex = v; } }, state.backgroundImage.url, state.backgroundImage.enabled, fade);
-    swapLayer(textLayers, { get value() { return textIndex; }, set value(v) { textIndex = v; } }, state.textImage.url, state.textImage.enabled, fade);
+    swapLayer(backgroundLayers, { get value() { return backgroundIndex; }, set value(v) { backgroundIndex = v; } }, assetUrl('background', state.backgroundImage), state.backgroundImage.enabled, fade);
+    showText(state, fade, updateStarted);
 
     if (state.overlay.enabled) {
-      if (overlay.dataset.src !== state.overlay.url) {
-        overlay.dataset.src = state.overlay.url;
-        overlay.src = state.overlay.url;
+      const overlayUrl = assetUrl('overlay', state.overlay);
+      if (overlay.dataset.src !== overlayUrl) {
+        overlay.dataset.src = overlayUrl;
+        overlay.src = overlayUrl;
       }
       overlay.classList.add('active');
     } else {
@@ -127,12 +269,22 @@
   }
 
   function connect() {
-    const socket = new WebSocket(`ws://${window.location.hostname}:15172`);
+    const socket = new WebSocket(`ws://${window.location.hostname}:15172/${inlineMode ? '?assets=inline' : ''}`);
+    socket.binaryType = 'arraybuffer';
     socket.addEventListener('message', (event) => {
+      if (!updateStarted) {
+        updateStarted = performance.now();
+      }
+      if (typeof event.data !== 'string') {
+        receiveAsset(event.data);
+        return;
+      }
+
       const state = JSON.parse(event.data);
       if (state.type === 'state') {
         applyState(state);
       }
+      updateStarted = 0;
     });
 
     socket.addEventListener('close', () => {
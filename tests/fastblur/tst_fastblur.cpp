@@ -0,0 +1,262 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include <QtTest>
+#include <QApplication>
+#include <QGraphicsBlurEffect>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsScene>
+#include <QPainter>
+#include "fastblur.hpp"
+
+namespace {
+
+// Shadow map the way ImageGenerator draws it: opaque strokes in text lines
+QImage makeShadowMap(const QSize &size, quint32 seed)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QRandomGenerator rng(seed);
+    QPainter painter(&image);
+    int lineHeight = qMax(8, size.height() / 8);
+    for (int line = 0; line < 4; ++line) {
+        int top = size.height() / 6 + line * lineHeight * 3 / 2;
+        for (int left = size.width() / 10; left < size.width() * 9 / 10; left += lineHeight * 3 / 5) {
+            int strokes = 2 + rng.bounded(3);
+            for (int i = 0; i < strokes; ++i) {
+                int thickness = 2 + rng.bounded(lineHeight / 10 + 1);
+                int length = lineHeight / 3 + rng.bounded(lineHeight / 2);
+                QPoint at(left + rng.bounded(lineHeight / 2), top + rng.bounded(lineHeight / 2));
+                if (rng.bounded(2))
+                    painter.fillRect(QRect(at, QSize(thickness, length)), QColor(20, 40, 60));
+                else
+                    painter.fillRect(QRect(at, QSize(length, thickness)), QColor(20, 40, 60));
+            }
+        }
+    }
+    return image;
+}
+
+QImage fastBlur(const QImage &source, int radius)
+{
+    QImage image = source;
+    FastBlur::blurPremultiplied(image, image.rect(), radius);
+    return image;
+}
+
+// The shadow blur ImageGenerator::applyEffectToImage used before FastBlur
+QImage graphicsEffectBlur(const QImage &source, int radius)
+{
+    QGraphicsBlurEffect *effect = new QGraphicsBlurEffect;
+    effect->setBlurRadius(radius);
+    QGraphicsScene scene;
+    QGraphicsPixmapItem item;
+    item.setPixmap(QPixmap::fromImage(source));
+    item.setGraphicsEffect(effect);
+    scene.addItem(&item);
+    QPixmap result(source.size());
+    result.fill(Qt::transparent);
+    QPainter painter(&result);
+    scene.render(&painter);
+    painter.end();
+    scene.removeItem(&item);
+    return result.toImage().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+bool colourWithinAlpha(const QImage &image)
+{
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            int a = qAlpha(line[x]);
+            if (qRed(line[x]) > a || qGreen(line[x]) > a || qBlue(line[x]) > a)
+                return false;
+        }
+    }
+    return true;
+}
+
+}
+
+class FastBlurTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void implementationsAgree_data();
+    void implementationsAgree();
+    void staysInsideRect();
+    void matchesGraphicsEffect_data();
+    void matchesGraphicsEffect();
+    void throughput_data();
+    void throughput();
+    void cleanup();
+};
+
+void FastBlurTest::implementationsAgree_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("radius");
+
+    // Odd sizes leave lines over for the scalar tail of the vector loops,
+    // 300 is clamped to the largest box the 16 bit sums can hold
+    const QList<QSize> sizes = {QSize(333, 217), QSize(64, 3), QSize(5, 97), QSize(1920, 1080)};
+    const QList<int> radii = {1, 2, 5, 12, 40, 300};
+    for (const QSize &size : sizes) {
+        for (int radius : radii) {
+            QTest::addRow("%dx%d r%d", size.width(), size.height(), radius) << size << radius;
+        }
+    }
+}
+
+void FastBlurTest::implementationsAgree()
+{
+    QFETCH(QSize, size);
+    QFETCH(int, radius);
+
+    QImage source = makeShadowMap(size, quint32(size.width() * 31 + radius));
+    QVERIFY(FastBlur::setImplementation(FastBlur::Scalar));
+    QImage scalar = fastBlur(source, radius);
+    QVERIFY(colourWithinAlpha(scalar));
+
+    const QList<FastBlur::Implementation> vectorPaths = {FastBlur::Sse2, FastBlur::Avx2};
+    for (FastBlur::Implementation implementation : vectorPaths) {
+        if (!FastBlur::setImplementation(implementation)) {
+            qWarning("Blur implementation %d is not available here", int(implementation));
+            continue;
+        }
+        QCOMPARE(fastBlur(source, radius), scalar);
+    }
+}
+
+void FastBlurTest::staysInsideRect()
+{
+    // Only the rect plus the blur extent may change
+    QImage source = makeShadowMap(QSize(400, 300), 7);
+    QImage image = source;
+    QRect rect(120, 90, 100, 60);
+    int radius = 6;
+    FastBlur::blurPremultiplied(image, rect, radius);
+
+    int spread = FastBlur::extent(radius);
+    QRect touched = rect.adjusted(-spread, -spread, spread, spread);
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            if (!touched.contains(x, y))
+                QCOMPARE(image.pixel(x, y), source.pixel(x, y));
+        }
+    }
+}
+
+void FastBlurTest::matchesGraphicsEffect_data()
+{
+    QTest::addColumn<int>("radius");
+    const QList<int> radii = {2, 3, 5, 8, 12, 20};
+    for (int radius : radii)
+        QTest::addRow("r%d", radius) << radius;
+}
+
+void FastBlurTest::matchesGraphicsEffect()
+{
+    // QGraphicsBlurEffect is an exponential blur on a half-scaled copy, so
+    // the box blur only approximates it. A port of both to plain C++ put
+    // the mean alpha difference near 3 and the worst pixel near 52 at
+    // these radii; the limits leave room for rounding in Qt's scaling.
+    QFETCH(int, radius);
+
+    QImage source = makeShadowMap(QSize(640, 360), quint32(radius));
+    QImage expected = graphicsEffectBlur(source, radius);
+    QImage actual = fastBlur(source, radius);
+    QCOMPARE(actual.size(), expected.size());
+
+    qint64 difference = 0, expectedCoverage = 0, actualCoverage = 0;
+    int worst = 0;
+    for (int y = 0; y < actual.height(); ++y) {
+        const QRgb *a = reinterpret_cast<const QRgb*>(actual.constScanLine(y));
+        const QRgb *e = reinterpret_cast<const QRgb*>(expected.constScanLine(y));
+        for (int x = 0; x < actual.width(); ++x) {
+            int d = qAbs(qAlpha(a[x]) - qAlpha(e[x]));
+            difference += d;
+            worst = qMax(worst, d);
+            actualCoverage += qAlpha(a[x]);
+            expectedCoverage += qAlpha(e[x]);
+        }
+    }
+    double mean = double(difference) / (actual.width() * actual.height());
+    double coverage = double(actualCoverage) / qMax<qint64>(1, expectedCoverage);
+    qInfo("radius %d: mean alpha difference %.2f, worst %d, coverage %.3f", radius, mean, worst, coverage);
+    QVERIFY2(mean <= 8, qPrintable(QString::number(mean)));
+    QVERIFY2(worst <= 96, qPrintable(QString::number(worst)));
+    QVERIFY2(qAbs(coverage - 1) <= 0.05, qPrintable(QString::number(coverage)));
+}
+
+void FastBlurTest::throughput_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("implementation");
+
+    // -1 is the QGraphicsBlurEffect path FastBlur replaced
+    const QList<QSize> sizes = {QSize(1920, 1080), QSize(3840, 2160)};
+    for (const QSize &size : sizes) {
+        QTest::addRow("%dp graphics effect", size.height()) << size << -1;
+        QTest::addRow("%dp scalar", size.height()) << size << int(FastBlur::Scalar);
+        QTest::addRow("%dp sse2", size.height()) << size << int(FastBlur::Sse2);
+        QTest::addRow("%dp avx2", size.height()) << size << int(FastBlur::Avx2);
+    }
+}
+
+void FastBlurTest::throughput()
+{
+    QFETCH(QSize, size);
+    QFETCH(int, implementation);
+
+    // Full screen text at the default shadow radius
+    const int radius = 5;
+    QImage source = makeShadowMap(size, 1);
+    if (implementation < 0) {
+        QBENCHMARK {
+            graphicsEffectBlur(source, radius);
+        }
+        return;
+    }
+
+    if (!FastBlur::setImplementation(FastBlur::Implementation(implementation)))
+        QSKIP("Blur implementation is not available here");
+    QImage image = source;
+    QBENCHMARK {
+        FastBlur::blurPremultiplied(image, image.rect(), radius);
+    }
+}
+
+void FastBlurTest::cleanup()
+{
+    FastBlur::setImplementation(FastBlur::Automatic);
+}
+
+int main(int argc, char *argv[])
+{
+    // Nothing is shown, so no display is needed
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    FastBlurTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_fastblur.moc"
@@ -0,0 +1,32 @@
+##**************************************************************************
+##
+##    softProjector - an open source media projection software
+##    Copyright (C) 2017  Vladislav Kobzar
+##
+##    This program is free software: you can redistribute it and/or modify
+##    it under the terms of the GNU General Public License as published by
+##    the Free Software Foundation version 3 of the License.
+##
+##    This program is distributed in the hope that it will be useful,
+##    but WITHOUT ANY WARRANTY; without even the implied warranty of
+##    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+##    GNU General Public License for more details.
+##
+##    You should have received a copy of the GNU General Public License
+##    along with this program.  If not, see <http:##www.gnu.org/licenses/>.
+##
+##**************************************************************************
+
+
+# Times the per-slide queries before and after the database version 4
+# migration (integer BibleVerse ids plus indexes)
+
+include(../tests.pri)
+
+QT += sql
+
+TARGET = tst_hotqueries
+
+SOURCES += tst_hotqueries.cpp \
+    $${SP_SRC}/sources/databaseindexes.cpp
+HEADERS += $${SP_SRC}/headers/databaseindexes.hpp
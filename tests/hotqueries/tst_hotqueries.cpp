@@ -0,0 +1,234 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include <QtTest>
+#include <QtSql>
+#include "databaseindexes.hpp"
+
+namespace {
+
+// Roughly the 9 installed translations of the request: ~280k verses
+const int bibleCount = 9;
+const int bookCount = 66;
+const int chapterCount = 25;
+const int verseCount = 19;
+const int themeCount = 50;
+
+const QString legacyConnection = QStringLiteral("legacy");
+
+QString verseId(int book, int chapter, int verse)
+{
+    return QString("B%1C%2V%3").arg(book, 3, 10, QLatin1Char('0'))
+            .arg(chapter, 3, 10, QLatin1Char('0')).arg(verse, 3, 10, QLatin1Char('0'));
+}
+
+// Creates the schema of database version 3, which had TEXT ids and no indexes
+void fillLegacyDatabase(QSqlDatabase db)
+{
+    QSqlQuery sq(db);
+    sq.exec("CREATE TABLE 'BibleBooks' ('bible_id' INTEGER, 'id' INTEGER, 'book_name' TEXT, 'chapter_count' INTEGER)");
+    sq.exec("CREATE TABLE 'BibleVerse' ('verse_id' TEXT, 'bible_id' TEXT, 'book' TEXT, "
+            "'chapter' INTEGER, 'verse' INTEGER, 'verse_text' TEXT)");
+    sq.exec("CREATE TABLE 'Songs' ('id' INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, 'songbook_id' INTEGER, "
+            "'number' INTEGER, 'title' TEXT)");
+    sq.exec("CREATE TABLE 'Slides' ('id' INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, 'ss_id' INTEGER, 'p_order' INTEGER)");
+    QStringList themeTables = {"ThemeAnnounce", "ThemeBible", "ThemePassive", "ThemeSong"};
+    for (const QString &tableName : themeTables)
+        sq.exec(QString("CREATE TABLE '%1' ('theme_id' INTEGER, 'disp' INTEGER, 'text_font' TEXT)").arg(tableName));
+
+    db.transaction();
+    QSqlQuery bq(db);
+    bq.prepare("INSERT INTO BibleBooks (bible_id, id, book_name, chapter_count) VALUES (?, ?, ?, ?)");
+    QSqlQuery vq(db);
+    vq.prepare("INSERT INTO BibleVerse (verse_id, bible_id, book, chapter, verse, verse_text) VALUES (?, ?, ?, ?, ?, ?)");
+    for (int bible = 1; bible <= bibleCount; ++bible) {
+        for (int book = 1; book <= bookCount; ++book) {
+            bq.addBindValue(bible);
+            bq.addBindValue(book);
+            bq.addBindValue(QString("Book %1").arg(book));
+            bq.addBindValue(chapterCount);
+            bq.exec();
+            for (int chapter = 1; chapter <= chapterCount; ++chapter) {
+                for (int verse = 1; verse <= verseCount; ++verse) {
+                    vq.addBindValue(verseId(book, chapter, verse));
+                    vq.addBindValue(QString::number(bible));
+                    vq.addBindValue(QString::number(book));
+                    vq.addBindValue(chapter);
+                    vq.addBindValue(verse);
+                    vq.addBindValue(QString("Bible %1, %2 %3:%4").arg(bible).arg(book).arg(chapter).arg(verse));
+                    vq.exec();
+                }
+            }
+        }
+    }
+    QSqlQuery tq(db);
+    for (const QString &tableName : themeTables) {
+        tq.prepare(QString("INSERT INTO %1 (theme_id, disp, text_font) VALUES (?, ?, ?)").arg(tableName));
+        for (int theme = 1; theme <= themeCount; ++theme) {
+            for (int disp = 1; disp <= 4; ++disp) {
+                tq.addBindValue(theme);
+                tq.addBindValue(disp);
+                tq.addBindValue(QStringLiteral("Arial,40"));
+                tq.exec();
+            }
+        }
+    }
+    db.commit();
+}
+
+}
+
+class HotQueries : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void migrationKeepsVerses();
+    void verseLookup_data();
+    void verseLookup();
+    void operatorBible_data();
+    void operatorBible();
+    void themeLookup_data();
+    void themeLookup();
+    void cleanupTestCase();
+
+private:
+    void addConnectionColumn();
+    QTemporaryDir m_dir;
+};
+
+void HotQueries::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    QSqlDatabase legacy = QSqlDatabase::addDatabase("QSQLITE", legacyConnection);
+    legacy.setDatabaseName(m_dir.filePath("legacy.sqlite"));
+    QVERIFY(legacy.open());
+    fillLegacyDatabase(legacy);
+
+    // The migration works on the default connection, like it does in main()
+    QSqlDatabase migrated = QSqlDatabase::addDatabase("QSQLITE");
+    migrated.setDatabaseName(m_dir.filePath("migrated.sqlite"));
+    QVERIFY(migrated.open());
+    fillLegacyDatabase(migrated);
+    QVERIFY(migrateDatabaseForIndexes());
+}
+
+void HotQueries::migrationKeepsVerses()
+{
+    QSqlQuery lq(QSqlDatabase::database(legacyConnection));
+    QSqlQuery mq;
+    QVERIFY(lq.exec("SELECT COUNT(*) FROM BibleVerse"));
+    QVERIFY(mq.exec("SELECT COUNT(*) FROM BibleVerse"));
+    QVERIFY(lq.first() && mq.first());
+    QCOMPARE(mq.value(0).toInt(), lq.value(0).toInt());
+
+    // Ids keep matching after they lost their TEXT affinity
+    QVERIFY(mq.exec("SELECT typeof(bible_id), typeof(book) FROM BibleVerse LIMIT 1"));
+    QVERIFY(mq.first());
+    QCOMPARE(mq.value(0).toString(), QStringLiteral("integer"));
+    QCOMPARE(mq.value(1).toString(), QStringLiteral("integer"));
+
+    mq.prepare("SELECT verse_text FROM BibleVerse WHERE verse_id = ? AND bible_id = ?");
+    mq.addBindValue(verseId(43, 3, 16));
+    mq.addBindValue(5);
+    QVERIFY(mq.exec() && mq.first());
+    QCOMPARE(mq.value(0).toString(), QStringLiteral("Bible 5, 43 3:16"));
+}
+
+void HotQueries::addConnectionColumn()
+{
+    QTest::addColumn<QString>("connection");
+    QTest::newRow("text ids, no indexes") << legacyConnection;
+    QTest::newRow("integer ids, indexed") << QString(QSqlDatabase::defaultConnection);
+}
+
+void HotQueries::verseLookup_data()
+{
+    addConnectionColumn();
+}
+
+void HotQueries::verseLookup()
+{
+    // Bible::getVerseAndCaption, once per translation shown
+    QFETCH(QString, connection);
+    QSqlQuery sq(QSqlDatabase::database(connection));
+    sq.prepare("SELECT book,chapter,verse,verse_text FROM BibleVerse WHERE verse_id = ? AND bible_id = ?");
+    int verse = 0;
+    QBENCHMARK {
+        ++verse;
+        sq.addBindValue(verseId(verse % bookCount + 1, verse % chapterCount + 1, verse % verseCount + 1));
+        sq.addBindValue(verse % bibleCount + 1);
+        QVERIFY(sq.exec());
+        QVERIFY(sq.first());
+    }
+}
+
+void HotQueries::operatorBible_data()
+{
+    addConnectionColumn();
+}
+
+void HotQueries::operatorBible()
+{
+    // Bible::loadOperatorBible, on every translation switch
+    QFETCH(QString, connection);
+    QSqlQuery sq(QSqlDatabase::database(connection));
+    sq.setForwardOnly(true);
+    sq.prepare("SELECT verse_id, book, chapter, verse, verse_text FROM BibleVerse WHERE bible_id = ?");
+    QBENCHMARK {
+        sq.addBindValue(3);
+        QVERIFY(sq.exec());
+        int rows = 0;
+        while (sq.next())
+            ++rows;
+        QCOMPARE(rows, bookCount * chapterCount * verseCount);
+    }
+}
+
+void HotQueries::themeLookup_data()
+{
+    addConnectionColumn();
+}
+
+void HotQueries::themeLookup()
+{
+    // Theme::loadBible/loadSong, on every slide of the stream theme
+    QFETCH(QString, connection);
+    QSqlQuery sq(QSqlDatabase::database(connection));
+    sq.prepare("SELECT * FROM ThemeBible WHERE theme_id = ? and disp = ?");
+    int theme = 0;
+    QBENCHMARK {
+        ++theme;
+        sq.addBindValue(theme % themeCount + 1);
+        sq.addBindValue(theme % 4 + 1);
+        QVERIFY(sq.exec());
+        QVERIFY(sq.first());
+    }
+}
+
+void HotQueries::cleanupTestCase()
+{
+    QSqlDatabase::database(legacyConnection).close();
+    QSqlDatabase::database().close();
+}
+
+QTEST_GUILESS_MAIN(HotQueries)
+#include "tst_hotqueries.moc"
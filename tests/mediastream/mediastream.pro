@@ -0,0 +1,35 @@
+##**************************************************************************
+##
+##    softProjector - an open source media projection software
+##    Copyright (C) 2017  Vladislav Kobzar
+##
+##    This program is free software: you can redistribute it and/or modify
+##    it under the terms of the GNU General Public License as published by
+##    the Free Software Foundation version 3 of the License.
+##
+##    This program is distributed in the hope that it will be useful,
+##    but WITHOUT ANY WARRANTY; without even the implied warranty of
+##    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+##    GNU General Public License for more details.
+##
+##    You should have received a copy of the GNU General Public License
+##    along with this program.  If not, see <http:##www.gnu.org/licenses/>.
+##
+##**************************************************************************
+
+
+
+# Loads the virtual output media server with keep-alive clients that send
+# random Range requests against a sparse multi-GB file
+
+include(../tests.pri)
+
+QT += gui network websockets concurrent
+
+TARGET = tst_mediastream
+
+SOURCES += tst_mediastream.cpp \
+    $${SP_SRC}/sources/virtualoutputserver.cpp \
+    $${SP_SRC}/sources/virtualoutputstream.cpp
+HEADERS += $${SP_SRC}/headers/virtualoutputserver.hpp \
+    $${SP_SRC}/headers/virtualoutputstream.hpp
@@ -0,0 +1,477 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include <QtTest>
+#include <QHostAddress>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include "virtualoutputserver.hpp"
+
+namespace {
+
+// Past 4 GB, so offsets need all 64 bits and no range can be buffered whole
+const qint64 fileSize = Q_INT64_C(5) << 30;
+
+// The file is sparse except for a block of known bytes every islandStride,
+// which keeps it cheap to create while bodies still have content to compare
+const qint64 islandStride = Q_INT64_C(256) << 20;
+const qint64 islandSize = Q_INT64_C(1) << 20;
+
+const int clientCount = 8;
+const int requestsPerClient = 12;
+
+// Slow clients take this much per tick and let the kernel buffers fill up
+const qint64 slowReadSize = 64 * 1024;
+const int slowReadInterval = 2;
+
+// The server holds at most 512 KB per socket, bodies that get buffered
+// would show up as hundreds of MB here
+const qint64 maxAnonymousGrowth = Q_INT64_C(64) << 20;
+
+const int testTimeout = 300000;
+
+const QString mediaFileName = QStringLiteral("sparse-media.bin");
+
+quint8 expectedByte(qint64 offset)
+{
+    if (offset % islandStride >= islandSize)
+        return 0;
+    const quint64 x = quint64(offset) * Q_UINT64_C(0x9E3779B97F4A7C15);
+    return quint8(x >> 56);
+}
+
+qint64 randomBelow(QRandomGenerator &random, qint64 bound)
+{
+    return qint64(random.generate64() % quint64(bound));
+}
+
+// Anonymous memory of the process. Mapped file pages are left out on
+// purpose, the page cache is what the server is supposed to use.
+qint64 anonymousMemory()
+{
+#ifdef Q_OS_LINUX
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (status.open(QIODevice::ReadOnly)) {
+        for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+            if (line.startsWith("RssAnon:"))
+                return line.mid(8).trimmed().split(' ').first().toLongLong() * 1024;
+        }
+    }
+#endif
+    return -1;
+}
+
+// Number of mappings of the media file the process holds, -1 if unknown
+int mediaMappings()
+{
+#ifdef Q_OS_LINUX
+    QFile maps(QStringLiteral("/proc/self/maps"));
+    if (maps.open(QIODevice::ReadOnly)) {
+        int count = 0;
+        for (QByteArray line = maps.readLine(); !line.isEmpty(); line = maps.readLine()) {
+            if (line.trimmed().endsWith(mediaFileName.toUtf8()))
+                ++count;
+        }
+        return count;
+    }
+#endif
+    return -1;
+}
+
+struct RangeRequest
+{
+    QByteArray range;
+    // Inclusive byte positions the server has to answer with
+    qint64 first;
+    qint64 last;
+};
+
+RangeRequest boundedRange(qint64 first, qint64 length)
+{
+    RangeRequest request;
+    request.first = first;
+    request.last = qMin(first + length, fileSize) - 1;
+    request.range = "bytes=" + QByteArray::number(first) + "-" + QByteArray::number(first + length - 1);
+    return request;
+}
+
+RangeRequest randomRange(QRandomGenerator &random)
+{
+    RangeRequest request;
+    switch (random.bounded(4)) {
+    case 0: {
+        // Across the end of a block of known bytes
+        const qint64 island = randomBelow(random, fileSize / islandStride);
+        const qint64 first = qMax<qint64>(0, island * islandStride + islandSize - randomBelow(random, 2 << 20));
+        return boundedRange(first, 1 + randomBelow(random, 8 << 20));
+    }
+    case 1:
+        return boundedRange(randomBelow(random, fileSize - (16 << 20)), 1 + randomBelow(random, 16 << 20));
+    case 2:
+        // Open ended, the way media elements ask for the rest of the file
+        request.first = fileSize - 1 - randomBelow(random, 4 << 20);
+        request.last = fileSize - 1;
+        request.range = "bytes=" + QByteArray::number(request.first) + "-";
+        return request;
+    default: {
+        const qint64 length = 1 + randomBelow(random, 4 << 20);
+        request.first = fileSize - length;
+        request.last = fileSize - 1;
+        request.range = "bytes=-" + QByteArray::number(length);
+        return request;
+    }
+    }
+}
+
+}
+
+// Keep-alive HTTP client that sends its requests with up to pipelineDepth
+// of them outstanding and compares every body byte with the file
+class RangeClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    RangeClient(quint16 port, const QList<RangeRequest> &requests, int pipelineDepth,
+                bool slowReader, qint64 abortAfter = -1, QObject *parent = nullptr);
+
+    bool isDone() const { return m_done; }
+    QString error() const { return m_error; }
+    int answered() const { return m_answered; }
+    qint64 bodyBytes() const { return m_bodyBytes; }
+
+private slots:
+    void sendRequests();
+    void readResponses();
+    void onDisconnected();
+
+private:
+    bool readHead();
+    bool readBody();
+    void fail(const QString &message);
+
+    QTcpSocket m_socket;
+    QTimer m_readTimer;
+    QList<RangeRequest> m_requests;
+    int m_pipelineDepth;
+    bool m_slowReader;
+    qint64 m_abortAfter;
+    int m_sent;
+    int m_answered;
+    QList<QByteArray> m_head;
+    bool m_inBody;
+    qint64 m_bodyOffset;
+    qint64 m_bodyRemaining;
+    qint64 m_bodyBytes;
+    bool m_done;
+    QString m_error;
+};
+
+RangeClient::RangeClient(quint16 port, const QList<RangeRequest> &requests, int pipelineDepth,
+                         bool slowReader, qint64 abortAfter, QObject *parent)
+    : QObject(parent),
+      m_requests(requests),
+      m_pipelineDepth(pipelineDepth),
+      m_slowReader(slowReader),
+      m_abortAfter(abortAfter),
+      m_sent(0),
+      m_answered(0),
+      m_inBody(false),
+      m_bodyOffset(0),
+      m_bodyRemaining(0),
+      m_bodyBytes(0),
+      m_done(false)
+{
+    connect(&m_socket, SIGNAL(connected()), this, SLOT(sendRequests()));
+    connect(&m_socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    if (m_slowReader) {
+        // A full read buffer stops Qt from draining the kernel, so the
+        // server sees a socket that won't take more
+        m_socket.setReadBufferSize(slowReadSize);
+        connect(&m_readTimer, SIGNAL(timeout()), this, SLOT(readResponses()));
+        m_readTimer.start(slowReadInterval);
+    } else {
+        connect(&m_socket, SIGNAL(readyRead()), this, SLOT(readResponses()));
+    }
+    m_socket.connectToHost(QHostAddress::LocalHost, port);
+}
+
+void RangeClient::sendRequests()
+{
+    while (m_sent < m_requests.size() && m_sent - m_answered < m_pipelineDepth) {
+        m_socket.write("GET /media/main HTTP/1.1\r\nHost: localhost\r\nRange: "
+                       + m_requests.at(m_sent).range + "\r\n\r\n");
+        ++m_sent;
+    }
+}
+
+void RangeClient::readResponses()
+{
+    while (!m_done && (m_inBody ? readBody() : readHead())) {
+    }
+}
+
+bool RangeClient::readHead()
+{
+    while (m_socket.canReadLine()) {
+        const QByteArray line = m_socket.readLine();
+        if (line != "\r\n") {
+            m_head << line.trimmed();
+            continue;
+        }
+
+        const RangeRequest &request = m_requests.at(m_answered);
+        const QByteArray contentRange = "bytes " + QByteArray::number(request.first) + "-"
+                + QByteArray::number(request.last) + "/" + QByteArray::number(fileSize);
+        QHash<QByteArray, QByteArray> headers;
+        for (int i = 1; i < m_head.size(); ++i) {
+            const int colon = m_head.at(i).indexOf(':');
+            headers.insert(m_head.at(i).left(colon).toLower(), m_head.at(i).mid(colon + 1).trimmed());
+        }
+        if (m_head.isEmpty() || m_head.first() != "HTTP/1.1 206 Partial Content") {
+            fail(QStringLiteral("unexpected status for %1: %2")
+                 .arg(QString::fromLatin1(request.range), QString::fromLatin1(m_head.value(0))));
+        } else if (headers.value("content-range") != contentRange) {
+            fail(QStringLiteral("%1 answered with %2")
+                 .arg(QString::fromLatin1(request.range), QString::fromLatin1(headers.value("content-range"))));
+        } else if (headers.value("content-length").toLongLong() != request.last - request.first + 1) {
+            fail(QStringLiteral("wrong length for %1").arg(QString::fromLatin1(request.range)));
+        } else if (headers.value("connection") != "keep-alive") {
+            fail(QStringLiteral("connection not kept alive after %1").arg(QString::fromLatin1(request.range)));
+        }
+        if (m_done)
+            return false;
+
+        m_head.clear();
+        m_inBody = true;
+        m_bodyOffset = request.first;
+        m_bodyRemaining = request.last - request.first + 1;
+        return true;
+    }
+    return false;
+}
+
+bool RangeClient::readBody()
+{
+    // Reads only what arrived, asking for the whole body would allocate it
+    qint64 wanted = qMin(m_bodyRemaining, m_socket.bytesAvailable());
+    if (m_slowReader)
+        wanted = qMin(wanted, slowReadSize);
+    const QByteArray data = m_socket.read(wanted);
+    if (data.isEmpty())
+        return false;
+
+    const char *bytes = data.constData();
+    for (int i = 0; i < data.size(); ++i) {
+        if (quint8(bytes[i]) != expectedByte(m_bodyOffset + i)) {
+            fail(QStringLiteral("byte %1 differs").arg(m_bodyOffset + i));
+            return false;
+        }
+    }
+    m_bodyOffset += data.size();
+    m_bodyRemaining -= data.size();
+    m_bodyBytes += data.size();
+
+    if (m_abortAfter >= 0 && m_bodyBytes >= m_abortAfter) {
+        // Walks away halfway through the body
+        m_done = true;
+        m_readTimer.stop();
+        m_socket.abort();
+        return false;
+    }
+    if (m_bodyRemaining > 0)
+        return !m_slowReader;
+
+    m_inBody = false;
+    ++m_answered;
+    if (m_answered == m_requests.size()) {
+        m_done = true;
+        m_readTimer.stop();
+        m_socket.disconnectFromHost();
+        return false;
+    }
+    sendRequests();
+    return !m_slowReader;
+}
+
+void RangeClient::onDisconnected()
+{
+    if (!m_done)
+        fail(QStringLiteral("server closed the connection after %1 responses").arg(m_answered));
+}
+
+void RangeClient::fail(const QString &message)
+{
+    if (m_error.isEmpty())
+        m_error = message;
+    m_done = true;
+    m_readTimer.stop();
+    m_socket.abort();
+}
+
+class MediaStreamTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void keepAliveRanges();
+    void pipelinedAfterStream();
+    void disconnectUnmaps();
+    void cleanupTestCase();
+
+private:
+    bool runClients(const QList<RangeClient*> &clients, qint64 *peakAnonymous, int *peakMappings);
+
+    QTemporaryDir m_dir;
+    VirtualOutputServer m_server;
+};
+
+void MediaStreamTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    QFile file(m_dir.filePath(mediaFileName));
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    if (!file.resize(fileSize))
+        QSKIP("No room for a sparse multi-GB file here");
+    QByteArray island(int(islandSize), Qt::Uninitialized);
+    for (qint64 offset = 0; offset < fileSize; offset += islandStride) {
+        for (int i = 0; i < island.size(); ++i)
+            island[i] = char(expectedByte(offset + i));
+        QVERIFY(file.seek(offset));
+        QCOMPARE(file.write(island), islandSize);
+    }
+    file.close();
+
+    QVERIFY(m_server.start(0, 0));
+    QSharedPointer<VirtualOutputSnapshot> snapshot(new VirtualOutputSnapshot);
+    snapshot->mainVideoPath = file.fileName();
+    m_server.publish(snapshot);
+}
+
+bool MediaStreamTest::runClients(const QList<RangeClient*> &clients, qint64 *peakAnonymous, int *peakMappings)
+{
+    *peakAnonymous = anonymousMemory();
+    *peakMappings = mediaMappings();
+    QTimer sampler;
+    connect(&sampler, &QTimer::timeout, [&]() {
+        *peakAnonymous = qMax(*peakAnonymous, anonymousMemory());
+        *peakMappings = qMax(*peakMappings, mediaMappings());
+    });
+    sampler.start(20);
+
+    return QTest::qWaitFor([&]() {
+        for (RangeClient *client : clients) {
+            if (!client->isDone())
+                return false;
+        }
+        return true;
+    }, testTimeout);
+}
+
+void MediaStreamTest::keepAliveRanges()
+{
+    QRandomGenerator random(20171);
+    QList<RangeClient*> clients;
+    qint64 expectedBytes = 0;
+    for (int i = 0; i < clientCount; ++i) {
+        QList<RangeRequest> requests;
+        for (int r = 0; r < requestsPerClient; ++r) {
+            requests << randomRange(random);
+            expectedBytes += requests.last().last - requests.last().first + 1;
+        }
+        // A quarter of the clients read slowly, the rest pipeline up to three
+        clients << new RangeClient(m_server.httpPort(), requests, 1 + i % 3, i % 4 == 3, -1, this);
+    }
+
+    const qint64 anonymousBefore = anonymousMemory();
+    qint64 peakAnonymous = 0;
+    int peakMappings = 0;
+    QVERIFY2(runClients(clients, &peakAnonymous, &peakMappings), "clients timed out");
+
+    qint64 receivedBytes = 0;
+    for (RangeClient *client : clients) {
+        QVERIFY2(client->error().isEmpty(), qPrintable(client->error()));
+        QCOMPARE(client->answered(), requestsPerClient);
+        receivedBytes += client->bodyBytes();
+    }
+    QCOMPARE(receivedBytes, expectedBytes);
+
+    // One mapping per streaming socket at most, never one per request
+    if (peakMappings >= 0)
+        QVERIFY(peakMappings <= clientCount);
+    if (anonymousBefore >= 0) {
+        QVERIFY2(peakAnonymous - anonymousBefore < maxAnonymousGrowth,
+                 qPrintable(QStringLiteral("anonymous memory grew by %1 MB while serving %2 MB")
+                            .arg((peakAnonymous - anonymousBefore) >> 20).arg(receivedBytes >> 20)));
+    }
+    qDeleteAll(clients);
+}
+
+void MediaStreamTest::pipelinedAfterStream()
+{
+    // Every request is on the wire before the first body is read, so the
+    // rest wait in the server while a stream held back by a slow reader
+    // owns the socket
+    QList<RangeRequest> requests;
+    for (qint64 i = 0; i < 4; ++i)
+        requests << boundedRange(i * islandStride + islandSize / 2, islandSize + (2 << 20));
+    RangeClient client(m_server.httpPort(), requests, requests.size(), true);
+    QTRY_VERIFY_WITH_TIMEOUT(client.isDone(), testTimeout);
+    QVERIFY2(client.error().isEmpty(), qPrintable(client.error()));
+    QCOMPARE(client.answered(), int(requests.size()));
+}
+
+void MediaStreamTest::disconnectUnmaps()
+{
+    QList<RangeClient*> clients;
+    for (int i = 0; i < 4; ++i) {
+        // Far more than anyone reads before walking away
+        QList<RangeRequest> requests;
+        requests << boundedRange(qint64(i) * islandStride, Q_INT64_C(1) << 30);
+        clients << new RangeClient(m_server.httpPort(), requests, 1, i % 2 == 1, qint64(i + 1) << 22, this);
+    }
+    qint64 peakAnonymous = 0;
+    int peakMappings = 0;
+    QVERIFY2(runClients(clients, &peakAnonymous, &peakMappings), "clients timed out");
+    for (RangeClient *client : clients)
+        QVERIFY2(client->error().isEmpty(), qPrintable(client->error()));
+    qDeleteAll(clients);
+
+    if (peakMappings < 0)
+        QSKIP("Mappings can't be inspected on this platform");
+    QTRY_COMPARE_WITH_TIMEOUT(mediaMappings(), 0, 5000);
+
+    // The server keeps serving after the aborted streams
+    QList<RangeRequest> requests;
+    requests << boundedRange(islandStride - 1024, 2048);
+    RangeClient client(m_server.httpPort(), requests, 1, false);
+    QTRY_VERIFY_WITH_TIMEOUT(client.isDone(), testTimeout);
+    QVERIFY2(client.error().isEmpty(), qPrintable(client.error()));
+}
+
+void MediaStreamTest::cleanupTestCase()
+{
+    m_server.stop();
+}
+
+QTEST_GUILESS_MAIN(MediaStreamTest)
+
+#include "tst_mediastream.moc"
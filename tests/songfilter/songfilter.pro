@@ -0,0 +1,41 @@
+##**************************************************************************
+##
+##    softProjector - an open source media projection software
+##    Copyright (C) 2017  Vladislav Kobzar
+##
+##    This program is free software: you can redistribute it and/or modify
+##    it under the terms of the GNU General Public License as published by
+##    the Free Software Foundation version 3 of the License.
+##
+##    This program is distributed in the hope that it will be useful,
+##    but WITHOUT ANY WARRANTY; without even the implied warranty of
+##    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+##    GNU General Public License for more details.
+##
+##    You should have received a copy of the GNU General Public License
+##    along with this program.  If not, see <http:##www.gnu.org/licenses/>.
+##
+##**************************************************************************
+
+
+
+# Times the song table filter on a catalog of about 6000 songs, the way
+# the search box of SongWidget re-filters it on every keystroke
+
+include(../tests.pri)
+
+QT += gui sql
+
+TARGET = tst_songfilter
+
+SOURCES += tst_songfilter.cpp \
+    $${SP_SRC}/sources/song.cpp \
+    $${SP_SRC}/sources/settings.cpp \
+    $${SP_SRC}/sources/spfunctions.cpp \
+    $${SP_SRC}/sources/songsearchindex.cpp \
+    $${SP_SRC}/sources/sqlstatementcache.cpp
+HEADERS += $${SP_SRC}/headers/song.hpp \
+    $${SP_SRC}/headers/settings.hpp \
+    $${SP_SRC}/headers/spfunctions.hpp \
+    $${SP_SRC}/headers/songsearchindex.hpp \
+    $${SP_SRC}/headers/sqlstatementcache.hpp
@@ -0,0 +1,172 @@
+/***************************************************************************
+//
+//    softProjector - an open source media projection software
+//    Copyright (C) 2017  Vladislav Kobzar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation version 3 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+***************************************************************************/
+
+#include <QtTest>
+#include "song.hpp"
+
+namespace {
+
+// About the size of a library with several large hymnals installed
+const int songbookCount = 6;
+const int songsPerSongbook = 1000;
+const int categoryCount = 12;
+
+// Latin and Cyrillic words, some with marks the filter folds away
+const QStringList titleWords = {
+    "Amazing", "Grace", "Holy", "Spirit", "Glory", "Lord", "Jesus", "Lamb",
+    "Élan", "Noël", "Crown", "River", "Morning", "Light", "Shepherd", "Cross",
+    "Слава", "Богу", "Ёлка", "Свята", "Ніч", "Господь", "Пастир", "Хвала",
+    "Світло", "Любов", "Радість", "Небо", "Христос", "Воскрес", "Йордан", "Мир"
+};
+
+QList<Song> makeCatalog()
+{
+    QList<Song> songs;
+    songs.reserve(songbookCount * songsPerSongbook);
+    quint32 seed = 2017;
+    for (int book = 1; book <= songbookCount; ++book) {
+        for (int number = 1; number <= songsPerSongbook; ++number) {
+            Song song(songs.size() + 1, number, QString::number(book), QString("Songbook %1").arg(book));
+            QStringList words;
+            const int wordCount = 2 + number % 4;
+            for (int i = 0; i < wordCount; ++i) {
+                seed = seed * 1103515245u + 12345u;
+                words << titleWords.at(int((seed >> 16) % quint32(titleWords.size())));
+            }
+            song.title = words.join(' ');
+            song.category = number % categoryCount;
+            songs << song;
+        }
+    }
+    return songs;
+}
+
+}
+
+class SongFilter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void filterMatches_data();
+    void filterMatches();
+    void typing_data();
+    void typing();
+
+private:
+    void expectRows(const QString &text, bool matchBeginning, bool exactMatch);
+
+    SongsModel m_songs;
+    SongProxyModel m_proxy;
+};
+
+void SongFilter::initTestCase()
+{
+    m_songs.setSongs(makeCatalog());
+    QCOMPARE(m_songs.rowCount(), songbookCount * songsPerSongbook);
+
+    // Set up like SongWidget does it
+    m_proxy.setSourceModel(&m_songs);
+    m_proxy.setDynamicSortFilter(true);
+    m_proxy.setSongbookFilter("ALL");
+    m_proxy.setCategoryFilter(-1);
+    m_proxy.sort(2);
+}
+
+void SongFilter::filterMatches_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("matchBeginning");
+    QTest::addColumn<bool>("exactMatch");
+
+    QTest::newRow("word") << "grace" << false << false;
+    QTest::newRow("two words") << "holy spirit" << false << false;
+    QTest::newRow("folded marks") << "elan" << false << false;
+    QTest::newRow("folded cyrillic") << "елка" << false << false;
+    QTest::newRow("upper case") << "СЛАВА" << false << false;
+    QTest::newRow("beginning") << "lord" << true << false;
+    QTest::newRow("number") << "42" << false << false;
+    QTest::newRow("exact number") << "42" << false << true;
+}
+
+void SongFilter::filterMatches()
+{
+    // The proxy has to agree with a plain scan of the catalog
+    QFETCH(QString, text);
+    QFETCH(bool, matchBeginning);
+    QFETCH(bool, exactMatch);
+
+    m_proxy.setFilterString(text, matchBeginning, exactMatch);
+
+    const QString key = SongsModel::filterKey(text);
+    QRegularExpression rx((matchBeginning ? "^" : "") + QString(key).replace(" ", "\\W*"));
+    int expected = 0;
+    for (int row = 0; row < m_songs.rowCount(); ++row) {
+        const QString title = SongsModel::filterKey(m_songs.song_list.at(row).title);
+        const QString number = QString::number(m_songs.song_list.at(row).number);
+        if (exactMatch ? (title == key || number == key)
+                       : (rx.match(title).hasMatch() || rx.match(number).hasMatch()))
+            ++expected;
+    }
+    QVERIFY(expected > 0);
+    QCOMPARE(m_proxy.rowCount(), expected);
+
+    m_proxy.setFilterString(QString(), false, false);
+    QCOMPARE(m_proxy.rowCount(), m_songs.rowCount());
+}
+
+void SongFilter::typing_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("matchBeginning");
+
+    QTest::newRow("title") << "amazing grace" << false;
+    QTest::newRow("title, beginning") << "amazing grace" << true;
+    QTest::newRow("cyrillic title") << "слава богу" << false;
+    QTest::newRow("number") << "512" << false;
+}
+
+void SongFilter::typing()
+{
+    // One re-filter per keystroke, then the search box is cleared again
+    QFETCH(QString, text);
+    QFETCH(bool, matchBeginning);
+
+    QBENCHMARK {
+        for (int length = 1; length <= text.size(); ++length) {
+            m_proxy.setFilterString(text.left(length), matchBeginning, false);
+            QVERIFY(m_proxy.rowCount() >= 0);
+        }
+        m_proxy.setFilterString(QString(), matchBeginning, false);
+        QCOMPARE(m_proxy.rowCount(), m_songs.rowCount());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Songs carry fonts and pixmaps, which need a GUI application but no display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    SongFilter test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_songfilter.moc"